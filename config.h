@@ -7,42 +7,130 @@ static const char col_unfocus[]    = "#676767";
 static const char col_focus[]      = "#ce5c00";
 static const int yreserve = 0, xreserve = 0;  /* screen space to reserve */
 
+/* PNG stretched over the root window, empty to leave the root alone. The
+ * scaled pixels are cached in bgcache below $HOME, per display in a farm */
+static const char background[]     = "";
+static const char bgcache[]        = ".speck-background";
+
+/* behaviour */
+static const long pingtimeout      = 3000;     /* ms to answer _NET_WM_PING */
+static const int outline           = 0;        /* 1 means drag outlines */
+static const int cascade           = 32;       /* offset between windows
+						  placed where none fits */
+
+/* resource accounting: every sampleinterval ms the CPU time and RSS of
+ * up to samplebatch clients are read from /proc, and with XRes (see
+ * config.mk) their pixmaps and windows are asked from the server. See
+ * _SPECK_USAGE on the root window and the SIGUSR1 dump. 0 disables */
+static const long sampleinterval   = 0;
+static const unsigned int samplebatch = 16;
+
+/* rate limits: configure, property and focus events a client may cause
+ * per second, in bursts of as many. Beyond that they are merged and handled
+ * ratedelay ms later, and a client that keeps it up for quarantine events
+ * is logged and held to that pace until it has been quiet for a while */
+static const float rates[RlLast] = {
+	[RlConfigure] = 60, [RlProperty] = 30, [RlFocus] = 10,
+};
+static const long ratedelay        = 100;
+static const unsigned int quarantine = 100;
+
+/* geometry memory: the last tag and floating geometry of every window
+ * class, instance and role are kept in this file below $HOME and given to
+ * the next such window before it maps. Empty to disable */
+static const char geomfile[]       = ".speck-geometry";
+static const unsigned int geomslots = 512;
+
+/* realtime: 1 keeps up to maxclients clients in an arena set up front and
+ * locks speck in memory once the displays are set up, which needs
+ * RLIMIT_MEMLOCK above its resident size (a few MB plus maxclients
+ * clients; ulimit -l or memlock in limits.conf). rtprio > 0 asks for
+ * SCHED_RR at that priority, otherwise nice is lowered by niceboost; both
+ * need the rlimits for it */
+static const int realtime          = 0;
+static const unsigned int maxclients = 256;
+static const int rtprio            = 0;
+static const int niceboost         = 10;
+
 /* tagging */
-static const unsigned int numtags = 4;
-static const unsigned int inittag = 1, altinittag = 2;
+static const unsigned int numtags = 4; /* at most 32 */
+static const unsigned int inittags = 1 << 0, altinittags = 1 << 1;
+
+static const long freezedelay = 2000; /* ms on a hidden tag before a client
+				       with the freeze rule is SIGSTOPped */
 
 static const Rule rules[] = {
 	/* xprop(1):
 	 *	WM_CLASS(STRING) = instance, class
 	 *	WM_NAME(STRING) = title
 	 */
-	/* class	instance	title		tag (<=numtags,!=0) */
-	{ "st",		NULL,		NULL,		2,		},
+	/* class	instance	title		tags (mask)	freeze */
+	{ "st",		NULL,		NULL,		1 << 1,		0 },
+};
+
+/* layout(s) */
+static const float mfact = 0.55; /* factor of master area size [0.05..0.95] */
+
+static const Layout layouts[] = {
+	/* symbol	arrange function */
+	{ "><>",	NULL },    /* first entry is default, no layout means floating */
+	{ "[]=",	tile },
+	{ "###",	grid },
 };
 
 /* key definitions */
 #define MODKEY (ControlMask|ShiftMask)
+#define TAGKEYS(KEY,TAG) \
+  { MODKEY,			KEY,	view,		{.ui = 1 << TAG } }, \
+  { MODKEY|Mod1Mask,		KEY,	tag,		{.ui = 1 << TAG } }, \
+  { MODKEY|Mod4Mask,		KEY,	toggleview,	{.ui = 1 << TAG } }, \
+  { MODKEY|Mod1Mask|Mod4Mask,	KEY,	toggletag,	{.ui = 1 << TAG } },
 
 /* commands */
 static const char *termcmd[] = { "st", NULL }; /* Edit at least this */
 
+/* hidden instances kept running so spawn shows a window at once, 0 for
+ * none. The commands must set _NET_WM_PID, an instance whose window lacks
+ * it shows up as an ordinary window and its slot is given up after
+ * launchtimeout ms */
+static const Pool pools[] = {
+	/* command	instances */
+	{ termcmd,	0 },
+};
+static const long pooldelay = 1000; /* ms until used instances are replaced */
+
+/* windows of programs spawned within launchtimeout ms go on the view they
+ * were spawned from, matched by _NET_WM_PID or the startup id */
+static const long launchtimeout = 30000;
+
+/* cgroup v2 subtree delegated to this user, e.g. below
+ * /sys/fs/cgroup/user.slice/user-1000.slice/user@1000.service, empty to
+ * disable. Clients are put into one child group per tag and the group of
+ * the visible tag gets cgboost as cpu.weight and io.weight */
+static const char cgroupdir[] = "";
+static const unsigned int cgweight = 100, cgboost = 1000;
+
 static Key keys[] = {
   /* modifier(s)	key		function	argument */
   { MODKEY,	 	XK_n,		spawn,          {.v = termcmd } },
   { Mod1Mask,		XK_Tab,		view,		{0} },
   { MODKEY, 		XK_semicolon,	focusstack,	{.i = +1 } },
   { MODKEY|Mod1Mask,	XK_semicolon,	focusstack,	{.i = -1 } },
+  { MODKEY,		XK_Tab,		focusmru,	{.i = +1 } },
+  { MODKEY|Mod1Mask,	XK_Tab,		focusmru,	{.i = -1 } },
   { MODKEY,	 	XK_w,		killclient,     {0} },
   { MODKEY,	 	XK_comma,	minimize,	{0} },
   { MODKEY,	 	XK_period,	maximize,	{0} },
-  { MODKEY, 		XK_h,		view,           {.ui = 1 } },
-  { MODKEY, 		XK_j,		view,           {.ui = 2 } },
-  { MODKEY, 		XK_k,		view,           {.ui = 3 } },
-  { MODKEY, 		XK_l,		view,           {.ui = 4 } },
-  { MODKEY|Mod1Mask,	XK_h,		tag,		{.ui = 1 } },
-  { MODKEY|Mod1Mask,	XK_j,		tag,		{.ui = 2 } },
-  { MODKEY|Mod1Mask,	XK_k,		tag,		{.ui = 3 } },
-  { MODKEY|Mod1Mask,	XK_l,		tag,		{.ui = 4 } },
+  { MODKEY,		XK_f,		setlayout,	{.v = &layouts[0] } },
+  { MODKEY,		XK_t,		setlayout,	{.v = &layouts[1] } },
+  { MODKEY,		XK_g,		setlayout,	{.v = &layouts[2] } },
+  { MODKEY,		XK_space,	togglefloating,	{0} },
+  TAGKEYS(		XK_h,				0)
+  TAGKEYS(		XK_j,				1)
+  TAGKEYS(		XK_k,				2)
+  TAGKEYS(		XK_l,				3)
+  { MODKEY, 		XK_0,		view,           {.ui = ~0 } },
+  { MODKEY|Mod1Mask,	XK_0,		tag,            {.ui = ~0 } },
   { MODKEY, 		XK_q,		quit,           {0} },
 };
 
@@ -6,19 +6,23 @@ VERSION = 1.1
 X11INC = /usr/X11R6/include
 X11LIB = /usr/X11R6/lib
 
+# libpng, comment if you don't want speck to set the root background
+PNGLIBS = -lpng
+PNGFLAGS = -DPNG
+
+# libXRes, uncomment for the pixmap bytes and windows of each client
+#XRESLIBS = -lXRes
+#XRESFLAGS = -DXRES
+
 # includes and libs
 INCS = -I${X11INC}
-LIBS = -L${X11LIB} -lX11
+LIBS = -L${X11LIB} -lX11 ${PNGLIBS} ${XRESLIBS}
 
 # flags
-CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" # -D__OpenBSD__
+CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_GNU_SOURCE -D_POSIX_C_SOURCE=200809L -DVERSION=\"${VERSION}\" ${PNGFLAGS} ${XRESFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
 CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS}
 LDFLAGS  = ${LIBS}
 
-# Solaris
-#CFLAGS = -fast ${INCS} -DVERSION=\"${VERSION}\"
-#LDFLAGS = ${LIBS}
-
 # compiler and linker
 CC = cc
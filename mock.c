@@ -0,0 +1,1224 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * In-process mock display. It implements exactly the Xlib calls speck makes,
+ * so linking speck.o against mock.o instead of libX11 (make speck-mock)
+ * gives a window manager that talks to no server at all. Requests are only
+ * counted and replies come from a table filled by the session being played.
+ * That is either a synthetic one queued up in XOpenDisplay() or, given
+ * MOCK_REPLAY=file, a recording made with speck-record (see record.c).
+ * Once the session is drained speck receives SIGTERM and quits, and
+ * XCloseDisplay() prints how many events, requests, round trips and
+ * allocations the WM logic needed and how long it took, per phase of the
+ * synthetic session or per event type of a recording, along with the
+ * longest an event of that kind took to handle. MOCK_WINDOWS sets
+ * the number of windows of the synthetic session.
+ *
+ * speck runs with HOME set to a scratch directory that is removed at the
+ * end, so files it keeps there start empty and the user's stay untouched.
+ *
+ * When speck starts using another Xlib call it has to be added here.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/keysym.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#ifdef XRES
+#include <X11/extensions/XRes.h>
+#endif /* XRES */
+
+#include "record.h"
+#include "util.h"
+
+#define LENGTH(X)               (sizeof X / sizeof X[0])
+#define MODKEY                  (ControlMask|ShiftMask) /* as in config.h */
+#define ROOT                    0x100
+#define NBUCKETS                4096
+
+enum { PhSetup, PhQuit, PhMap, PhTag, PhView, PhLayout, PhConfigure,
+       PhProperty, PhFullscreen, PhDrag, PhMru, PhPlace, PhDestroy,
+       PhLast }; /* session phases */
+
+typedef struct Reply Reply;
+struct Reply {
+	Rec *rec;
+	size_t at; /* events that preceded it */
+	Reply *next;
+};
+
+typedef struct {
+	const char *name;
+	Atom atom;
+} AtomName;
+
+typedef struct {
+	unsigned long events, requests, replies, allocs, frees;
+	long usec, max; /* max is the slowest single event */
+} Stat;
+
+static void addreply(unsigned int kind, unsigned long win,
+		     unsigned long arg, int status, const void *data,
+		     size_t len);
+static void apply(Reply *rp);
+static Atom atom(const char *name);
+static int destroyimage(XImage *img);
+static void destroywin(Window w);
+static void enqueue(XEvent *ev);
+static void *grow(void *p, size_t size);
+static void key(unsigned int mod, KeySym ks);
+static KeyCode keycode(KeySym ks);
+static void load(const char *path);
+static Rec *lookup(unsigned int kind, unsigned long win, unsigned long arg);
+static Window mapwin(int x, int y, int w, int h, Window trans);
+static void mousedrag(Window w, unsigned int button, int steps);
+static long now(void);
+static XEvent *pop(void);
+static void reply(void);
+static void request(void);
+static void script(int n);
+static void setphase(int ph);
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static const char *phasename[PhLast] = {
+	"setup", "quit", "map", "tag", "view", "layout", "configure",
+	"property", "fullscreen", "drag", "mru", "place", "destroy",
+};
+static const char *evname[LASTEvent] = {
+	"setup", "quit", "KeyPress", "KeyRelease", "ButtonPress",
+	"ButtonRelease", "MotionNotify", "EnterNotify", "LeaveNotify",
+	"FocusIn", "FocusOut", "KeymapNotify", "Expose", "GraphicsExpose",
+	"NoExpose", "VisibilityNotify", "CreateNotify", "DestroyNotify",
+	"UnmapNotify", "MapNotify", "MapRequest", "ReparentNotify",
+	"ConfigureNotify", "ConfigureRequest", "GravityNotify",
+	"ResizeRequest", "CirculateNotify", "CirculateRequest",
+	"PropertyNotify", "SelectionClear", "SelectionRequest",
+	"SelectionNotify", "ColormapNotify", "ClientMessage",
+	"MappingNotify", "GenericEvent",
+};
+static const char **names = phasename;
+static int nnames = PhLast;
+static Stat stats[MAX(PhLast, LASTEvent)];
+static int phase = PhSetup, scriptphase;
+static long phasestart, lastpop;
+static XEvent *evq;
+static unsigned char *evph;
+static size_t nev, evcap, evhead;
+static Reply *buckets[NBUCKETS];
+static Reply *replies;
+static size_t nreplies, nextreply;
+static int replaying;
+static Window nextwin = 0x200000;
+static AtomName *atoms;
+static size_t natoms;
+static Atom nextatom = 100;
+static KeySym keysyms[256];
+static int ptrx, ptry;
+static Time evtime;
+static pid_t nextpid = 1 << 22;
+static char home[] = "/tmp/speck-mock-XXXXXX";
+static int quitting;
+static Screen scr;
+static Visual vis;
+static XErrorHandler errhandler;
+
+/* allocation counting, see the --wrap flags in the Makefile. The mock
+ * itself allocates through the __real functions so only speck is counted */
+void *
+__wrap_malloc(size_t size) {
+	stats[phase].allocs++;
+	return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size) {
+	stats[phase].allocs++;
+	return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *p, size_t size) {
+	if (!p)
+		stats[phase].allocs++;
+	return __real_realloc(p, size);
+}
+
+void
+__wrap_free(void *p) {
+	if (p)
+		stats[phase].frees++;
+	__real_free(p);
+}
+
+/* nothing is launched from a benchmark */
+int
+__wrap_posix_spawnp(pid_t *pid, const char *file,
+		    const posix_spawn_file_actions_t *fa,
+		    const posix_spawnattr_t *attr, char *const argv[],
+		    char *const envp[]) {
+	*pid = nextpid++;
+	return 0;
+}
+
+void
+addreply(unsigned int kind, unsigned long win, unsigned long arg, int status,
+	 const void *data, size_t len) {
+	Reply *rp;
+	Rec *r;
+
+	rp = grow(NULL, sizeof(Reply));
+	r = grow(NULL, sizeof(Rec) + len);
+	memset(r, 0, sizeof(Rec));
+	r->kind = kind;
+	r->len = len;
+	r->status = status;
+	r->win = win;
+	r->arg = arg;
+	memcpy(r + 1, data, len);
+	rp->rec = r;
+	apply(rp);
+}
+
+/* makes rp the answer to its call, replacing the previous one */
+void
+apply(Reply *rp) {
+	Rec *r = rp->rec;
+	Reply **p;
+
+	if (r->kind == RecAtom) {
+		atoms = grow(atoms, (natoms + 1) * sizeof(AtomName));
+		atoms[natoms].name = (char *)(r + 1);
+		atoms[natoms++].atom = r->arg;
+		nextatom = MAX(nextatom, r->arg + 1);
+		return;
+	}
+	p = &buckets[(r->kind * 31 + r->win * 17 + r->arg) % NBUCKETS];
+	for (; *p; p = &(*p)->next) {
+		if ((*p)->rec->kind == r->kind && (*p)->rec->win == r->win
+		&& (*p)->rec->arg == r->arg) {
+			(*p)->rec = r;
+			return;
+		}
+	}
+	rp->next = NULL;
+	*p = rp;
+}
+
+Atom
+atom(const char *name) {
+	size_t i;
+	char *s;
+
+	for (i = 0; i < natoms; i++)
+		if (!strcmp(atoms[i].name, name))
+			return atoms[i].atom;
+	s = grow(NULL, strlen(name) + 1);
+	strcpy(s, name);
+	atoms = grow(atoms, (natoms + 1) * sizeof(AtomName));
+	atoms[natoms].name = s;
+	return atoms[natoms++].atom = nextatom++;
+}
+
+int
+destroyimage(XImage *img) {
+	__real_free(img->data);
+	__real_free(img);
+	return 1;
+}
+
+void
+destroywin(Window w) {
+	XEvent ev = { 0 };
+
+	ev.xdestroywindow.type = DestroyNotify;
+	ev.xdestroywindow.event = ROOT;
+	ev.xdestroywindow.window = w;
+	enqueue(&ev);
+}
+
+void
+enqueue(XEvent *ev) {
+	if (nev == evcap) {
+		evcap = evcap ? evcap * 2 : 1024;
+		evq = grow(evq, evcap * sizeof(XEvent));
+		evph = grow(evph, evcap);
+	}
+	ev->xany.display = (Display *)scr.display;
+	evq[nev] = *ev;
+	evph[nev++] = scriptphase;
+}
+
+void *
+grow(void *p, size_t size) {
+	if (!(p = __real_realloc(p, size)))
+		die("mock: realloc:");
+	return p;
+}
+
+void
+key(unsigned int mod, KeySym ks) {
+	XEvent ev = { 0 };
+
+	ev.xkey.type = KeyPress;
+	ev.xkey.window = ev.xkey.root = ROOT;
+	ev.xkey.state = mod;
+	ev.xkey.keycode = keycode(ks);
+	ev.xkey.same_screen = True;
+	enqueue(&ev);
+}
+
+KeyCode
+keycode(KeySym ks) {
+	unsigned int i;
+
+	for (i = 8; i < 256 && keysyms[i] && keysyms[i] != ks; i++);
+	if (i == 256)
+		die("mock: out of keycodes");
+	keysyms[i] = ks;
+	return i;
+}
+
+/* reads a recording, its replies are applied as the events are taken */
+void
+load(const char *path) {
+	FILE *f;
+	char *buf = NULL;
+	size_t len = 0, n, off;
+	Rec *r;
+	RecScreen *rs;
+
+	if (!(f = fopen(path, "r")))
+		die("mock: cannot open %s:", path);
+	do {
+		buf = grow(buf, len + 65536);
+		len += n = fread(buf + len, 1, 65536, f);
+	} while (n);
+	fclose(f);
+	for (off = 0; off + sizeof(Rec) <= len;
+	     off += sizeof(Rec) + RECSIZE(r->len)) {
+		r = (Rec *)(buf + off);
+		if (off + sizeof(Rec) + r->len > len || r->kind >= RecLast)
+			die("mock: %s is truncated or corrupt", path);
+		switch (r->kind) {
+		case RecDisplay:
+			rs = (RecScreen *)(r + 1);
+			scr.root = r->win;
+			scr.width = rs->width;
+			scr.height = rs->height;
+			break;
+		case RecEvent:
+			scriptphase = ((XEvent *)(r + 1))->type;
+			if (scriptphase < 2 || scriptphase >= LASTEvent)
+				scriptphase = PhSetup;
+			enqueue((XEvent *)(r + 1));
+			break;
+		default:
+			replies = grow(replies, (nreplies + 1) * sizeof(Reply));
+			replies[nreplies].rec = r;
+			replies[nreplies++].at = nev;
+			break;
+		}
+	}
+	for (; nextreply < nreplies && !replies[nextreply].at; nextreply++)
+		apply(&replies[nextreply]);
+	replaying = 1;
+	names = evname;
+	nnames = LASTEvent;
+}
+
+Rec *
+lookup(unsigned int kind, unsigned long win, unsigned long arg) {
+	Reply *rp;
+
+	for (rp = buckets[(kind * 31 + win * 17 + arg) % NBUCKETS]; rp;
+	     rp = rp->next)
+		if (rp->rec->kind == kind && rp->rec->win == win
+		&& rp->rec->arg == arg)
+			return rp->rec;
+	return NULL;
+}
+
+Window
+mapwin(int x, int y, int w, int h, Window trans) {
+	XWindowAttributes wa = { 0 };
+	XEvent ev = { 0 };
+	Atom del;
+	Window win = nextwin++;
+
+	wa.x = x;
+	wa.y = y;
+	wa.width = w;
+	wa.height = h;
+	wa.root = ROOT;
+	wa.screen = &scr;
+	wa.map_state = IsUnmapped;
+	addreply(RecAttributes, win, 0, 1, &wa, sizeof wa);
+	if (trans)
+		addreply(RecTransient, win, 0, 1, &trans, sizeof trans);
+	addreply(RecClass, win, 0, 1, "bench\0Bench", 12);
+	del = atom("WM_DELETE_WINDOW");
+	addreply(RecProtocols, win, 0, 1, &del, sizeof del);
+
+	ev.xmaprequest.type = MapRequest;
+	ev.xmaprequest.parent = ROOT;
+	ev.xmaprequest.window = win;
+	enqueue(&ev);
+	return win;
+}
+
+/* press button on w, move the pointer in steps and let go */
+void
+mousedrag(Window w, unsigned int button, int steps) {
+	XEvent ev = { 0 };
+	int i;
+
+	ev.xbutton.type = ButtonPress;
+	ev.xbutton.window = w;
+	ev.xbutton.root = ROOT;
+	ev.xbutton.state = MODKEY;
+	ev.xbutton.button = button;
+	ev.xbutton.x_root = ev.xbutton.x = 400;
+	ev.xbutton.y_root = ev.xbutton.y = 300;
+	ev.xbutton.time = evtime += 20;
+	enqueue(&ev);
+	for (i = 1; i <= steps; i++) {
+		memset(&ev, 0, sizeof ev);
+		ev.xmotion.type = MotionNotify;
+		ev.xmotion.window = ev.xmotion.root = ROOT;
+		ev.xmotion.x = ev.xmotion.x_root = 400 + i * 7;
+		ev.xmotion.y = ev.xmotion.y_root = 300 + i * 5;
+		ev.xmotion.time = evtime += 20; /* beat the 60Hz throttle */
+		enqueue(&ev);
+	}
+	memset(&ev, 0, sizeof ev);
+	ev.xbutton.type = ButtonRelease;
+	ev.xbutton.window = ROOT;
+	ev.xbutton.button = button;
+	ev.xbutton.time = evtime += 20;
+	enqueue(&ev);
+}
+
+long
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* takes the next queued event */
+XEvent *
+pop(void) {
+	size_t i;
+	long t;
+
+	if (evhead == nev)
+		return NULL;
+	i = evhead++;
+	for (; nextreply < nreplies && replies[nextreply].at <= i + 1;
+	     nextreply++)
+		apply(&replies[nextreply]);
+	/* the previous event was handled by now */
+	t = now();
+	if (lastpop)
+		stats[phase].max = MAX(stats[phase].max, t - lastpop);
+	lastpop = t;
+	setphase(evph[i]);
+	stats[phase].events++;
+	if (evq[i].type == ButtonPress) {
+		ptrx = evq[i].xbutton.x_root;
+		ptry = evq[i].xbutton.y_root;
+	}
+	return &evq[i];
+}
+
+void
+reply(void) {
+	stats[phase].requests++;
+	stats[phase].replies++;
+}
+
+void
+request(void) {
+	stats[phase].requests++;
+}
+
+void
+script(int n) {
+	static const KeySym tagkeys[] = { XK_h, XK_j, XK_k, XK_l };
+	Window *w, *p;
+	int i;
+
+	w = grow(NULL, n * sizeof(Window));
+	p = grow(NULL, n * sizeof(Window));
+	scriptphase = PhMap;
+	for (i = 0; i < n; i++) /* every eighth window is a dialog */
+		w[i] = mapwin(i * 37 % 1500, i * 23 % 900, 200 + i % 300,
+			      150 + i % 200, i % 8 == 7 ? w[i - 1] : None);
+	scriptphase = PhTag;
+	for (i = 0; i < n; i++) {
+		key(MODKEY, XK_semicolon);
+		key(MODKEY|Mod1Mask, tagkeys[i % LENGTH(tagkeys)]);
+	}
+	scriptphase = PhView;
+	for (i = 0; i < 200; i++) {
+		key(MODKEY, tagkeys[i % LENGTH(tagkeys)]);
+		key(MODKEY|Mod4Mask, tagkeys[i * 7 % LENGTH(tagkeys)]);
+	}
+	scriptphase = PhLayout;
+	for (i = 0; i < 50; i++) {
+		key(MODKEY, XK_t);
+		key(MODKEY, tagkeys[i % LENGTH(tagkeys)]);
+		key(MODKEY, XK_g);
+		key(MODKEY, XK_f);
+	}
+	scriptphase = PhConfigure;
+	for (i = 0; i < n; i++) {
+		XEvent ev = { 0 };
+
+		ev.xconfigurerequest.type = ConfigureRequest;
+		ev.xconfigurerequest.parent = ROOT;
+		ev.xconfigurerequest.window = w[i];
+		ev.xconfigurerequest.x = i * 13 % 1200;
+		ev.xconfigurerequest.y = i * 11 % 700;
+		ev.xconfigurerequest.width = 300 + i % 100;
+		ev.xconfigurerequest.height = 200 + i % 100;
+		ev.xconfigurerequest.value_mask = CWX|CWY|CWWidth|CWHeight;
+		enqueue(&ev);
+	}
+	scriptphase = PhProperty;
+	for (i = 0; i < 2 * n; i++) {
+		XEvent ev = { 0 };
+
+		ev.xproperty.type = PropertyNotify;
+		ev.xproperty.window = w[i / 2];
+		ev.xproperty.atom = i % 2 ? XA_WM_NORMAL_HINTS : XA_WM_HINTS;
+		ev.xproperty.state = PropertyNewValue;
+		enqueue(&ev);
+	}
+	scriptphase = PhFullscreen;
+	for (i = 0; i < 40; i++) {
+		XEvent ev = { 0 };
+
+		if (i % 2 == 0)
+			key(MODKEY, tagkeys[i / 2 % LENGTH(tagkeys)]);
+		ev.xclient.type = ClientMessage;
+		ev.xclient.window = w[i / 2 * 7 % n];
+		ev.xclient.message_type = atom("_NET_WM_STATE");
+		ev.xclient.format = 32;
+		ev.xclient.data.l[0] = 2; /* _NET_WM_STATE_TOGGLE */
+		ev.xclient.data.l[1] = atom("_NET_WM_STATE_FULLSCREEN");
+		enqueue(&ev);
+	}
+	scriptphase = PhDrag;
+	for (i = 0; i < 20; i++) {
+		key(MODKEY, tagkeys[i % LENGTH(tagkeys)]);
+		mousedrag(w[i * 7 % n], i % 2 ? Button3 : Button1, 50);
+	}
+	scriptphase = PhMru;
+	for (i = 0; i < 50; i++) {
+		XEvent ev = { 0 };
+
+		key(MODKEY, XK_Tab);
+		key(MODKEY, XK_Tab);
+		ev.xkey.type = KeyRelease;
+		ev.xkey.window = ev.xkey.root = ROOT;
+		ev.xkey.keycode = keycode(XK_Control_L);
+		enqueue(&ev);
+	}
+	scriptphase = PhPlace; /* each window placed after the last one moved */
+	key(MODKEY, XK_f);
+	for (i = 0; i < n; i++) {
+		XEvent ev = { 0 };
+
+		p[i] = mapwin(0, 0, 150 + i % 250, 100 + i % 150, None);
+		if (i == n - 1)
+			break;
+		ev.xconfigurerequest.type = ConfigureRequest;
+		ev.xconfigurerequest.parent = ROOT;
+		ev.xconfigurerequest.window = p[i];
+		ev.xconfigurerequest.x = i * 29 % 1400;
+		ev.xconfigurerequest.y = i * 17 % 800;
+		ev.xconfigurerequest.value_mask = CWX|CWY;
+		enqueue(&ev);
+	}
+	scriptphase = PhDestroy;
+	for (i = 0; i < n; i++) {
+		destroywin(w[i]);
+		destroywin(p[i]);
+	}
+	__real_free(w);
+	__real_free(p);
+}
+
+void
+setphase(int ph) {
+	long t;
+
+	if (ph == phase)
+		return;
+	t = now();
+	stats[phase].usec += t - phasestart;
+	phasestart = t;
+	phase = ph;
+}
+
+/* Xlib */
+
+int
+XAllocNamedColor(Display *dpy, Colormap cmap, _Xconst char *name,
+		 XColor *screen, XColor *exact) {
+	reply();
+	screen->pixel = exact->pixel = strlen(name);
+	return 1;
+}
+
+int
+XAllowEvents(Display *dpy, int mode, Time time) {
+	request();
+	return 1;
+}
+
+int
+XChangeProperty(Display *dpy, Window w, Atom prop, Atom type, int format,
+		int mode, _Xconst unsigned char *data, int n) {
+	request();
+	return 1;
+}
+
+int
+XChangeWindowAttributes(Display *dpy, Window w, unsigned long mask,
+			XSetWindowAttributes *attrs) {
+	request();
+	return 1;
+}
+
+int
+XClearWindow(Display *dpy, Window w) {
+	request();
+	return 1;
+}
+
+int
+XCloseDisplay(Display *dpy) {
+	Stat t = { 0 };
+	DIR *dir;
+	struct dirent *de;
+	int i;
+
+	setphase(PhQuit);
+	setphase(PhSetup);
+	printf("%-16s %8s %9s %8s %8s %8s %10s %6s\n",
+	       replaying ? "event" : "phase", "events", "requests", "replies",
+	       "allocs", "frees", "usec", "max");
+	for (i = 0; i < nnames; i++) {
+		if (replaying && !stats[i].events && !stats[i].requests)
+			continue;
+		printf("%-16s %8lu %9lu %8lu %8lu %8lu %10ld %6ld\n", names[i],
+		       stats[i].events, stats[i].requests, stats[i].replies,
+		       stats[i].allocs, stats[i].frees, stats[i].usec,
+		       stats[i].max);
+		t.events += stats[i].events;
+		t.requests += stats[i].requests;
+		t.replies += stats[i].replies;
+		t.allocs += stats[i].allocs;
+		t.frees += stats[i].frees;
+		t.usec += stats[i].usec;
+		t.max = MAX(t.max, stats[i].max);
+	}
+	printf("%-16s %8lu %9lu %8lu %8lu %8lu %10ld %6ld\n", "total",
+	       t.events, t.requests, t.replies, t.allocs, t.frees, t.usec,
+	       t.max);
+	if ((dir = opendir(home))) {
+		while ((de = readdir(dir)))
+			if (de->d_name[0] != '.' || (de->d_name[1]
+			    && strcmp(de->d_name, "..")))
+				unlinkat(dirfd(dir), de->d_name, 0);
+		closedir(dir);
+		rmdir(home);
+	}
+	return 0;
+}
+
+int
+XConfigureWindow(Display *dpy, Window w, unsigned int mask,
+		 XWindowChanges *wc) {
+	request();
+	return 1;
+}
+
+GC
+XCreateGC(Display *dpy, Drawable d, unsigned long mask, XGCValues *gv) {
+	static char gc;
+
+	request();
+	return (GC)&gc;
+}
+
+XImage *
+XCreateImage(Display *dpy, Visual *v, unsigned int depth, int format,
+	     int offset, char *data, unsigned int w, unsigned int h, int pad,
+	     int bpl) {
+	XImage *img;
+
+	img = grow(NULL, sizeof(XImage));
+	memset(img, 0, sizeof(XImage));
+	img->width = w;
+	img->height = h;
+	img->format = format;
+	img->data = data;
+	img->depth = depth;
+	img->bitmap_pad = pad;
+	img->bits_per_pixel = 32;
+	img->bytes_per_line = bpl ? bpl : w * 4;
+	img->f.destroy_image = destroyimage;
+	return img;
+}
+
+Pixmap
+XCreatePixmap(Display *dpy, Drawable d, unsigned int w, unsigned int h,
+	      unsigned int depth) {
+	request();
+	return nextwin++;
+}
+
+Window
+XCreateSimpleWindow(Display *dpy, Window parent, int x, int y,
+		    unsigned int w, unsigned int h, unsigned int bw,
+		    unsigned long border, unsigned long background) {
+	request();
+	return nextwin++;
+}
+
+int
+XDeleteProperty(Display *dpy, Window w, Atom prop) {
+	request();
+	return 1;
+}
+
+int
+XDestroyWindow(Display *dpy, Window w) {
+	request();
+	return 1;
+}
+
+int
+XDrawRectangle(Display *dpy, Drawable d, GC gc, int x, int y,
+	       unsigned int w, unsigned int h) {
+	request();
+	return 1;
+}
+
+int
+XFree(void *p) {
+	__real_free(p);
+	return 1;
+}
+
+int
+XFreeGC(Display *dpy, GC gc) {
+	request();
+	return 1;
+}
+
+int
+XFreeModifiermap(XModifierKeymap *modmap) {
+	if (modmap)
+		__real_free(modmap->modifiermap);
+	__real_free(modmap);
+	return 1;
+}
+
+int
+XFreePixmap(Display *dpy, Pixmap pm) {
+	request();
+	return 1;
+}
+
+Status
+XGetClassHint(Display *dpy, Window w, XClassHint *ch) {
+	Rec *r;
+	char *s;
+
+	reply();
+	if (!(r = lookup(RecClass, w, 0)) || !r->status)
+		return 0;
+	s = (char *)(r + 1);
+	ch->res_name = grow(NULL, strlen(s) + 1);
+	strcpy(ch->res_name, s);
+	s += strlen(s) + 1;
+	ch->res_class = grow(NULL, strlen(s) + 1);
+	strcpy(ch->res_class, s);
+	return r->status;
+}
+
+XModifierKeymap *
+XGetModifierMapping(Display *dpy) {
+	XModifierKeymap *modmap;
+	Rec *r;
+
+	reply();
+	modmap = grow(NULL, sizeof(XModifierKeymap));
+	memset(modmap, 0, sizeof(XModifierKeymap));
+	if ((r = lookup(RecModmap, 0, 0))) {
+		modmap->max_keypermod = *(int *)(r + 1);
+		modmap->modifiermap = grow(NULL, r->len - sizeof(int));
+		memcpy(modmap->modifiermap, (int *)(r + 1) + 1,
+		       r->len - sizeof(int));
+	}
+	return modmap;
+}
+
+Status
+XGetTransientForHint(Display *dpy, Window w, Window *trans) {
+	Rec *r;
+
+	reply();
+	if (!(r = lookup(RecTransient, w, 0)) || !r->status)
+		return 0;
+	*trans = *(Window *)(r + 1);
+	return r->status;
+}
+
+Status
+XGetWMClientMachine(Display *dpy, Window w, XTextProperty *tp) {
+	Rec *r;
+	size_t len;
+
+	reply();
+	if (!(r = lookup(RecMachine, w, 0)) || !r->status)
+		return 0;
+	*tp = *(XTextProperty *)(r + 1);
+	len = r->len - sizeof(XTextProperty);
+	tp->value = grow(NULL, len + 1);
+	memcpy(tp->value, (XTextProperty *)(r + 1) + 1, len);
+	tp->value[len] = '\0';
+	return r->status;
+}
+
+XWMHints *
+XGetWMHints(Display *dpy, Window w) {
+	XWMHints *wmh;
+	Rec *r;
+
+	reply();
+	if (!(r = lookup(RecWMHints, w, 0)) || !r->status)
+		return NULL;
+	wmh = grow(NULL, sizeof(XWMHints));
+	*wmh = *(XWMHints *)(r + 1);
+	return wmh;
+}
+
+Status
+XGetWMNormalHints(Display *dpy, Window w, XSizeHints *hints,
+		  long *supplied) {
+	Rec *r;
+
+	reply();
+	if (!(r = lookup(RecNormalHints, w, 0)) || !r->status)
+		return 0;
+	*hints = *(XSizeHints *)(r + 1);
+	*supplied = r->arg;
+	return r->status;
+}
+
+Status
+XGetWMProtocols(Display *dpy, Window w, Atom **protocols, int *n) {
+	Rec *r;
+
+	reply();
+	if (!(r = lookup(RecProtocols, w, 0)) || !r->status)
+		return 0;
+	*protocols = grow(NULL, r->len + 1);
+	memcpy(*protocols, r + 1, r->len);
+	*n = r->len / sizeof(Atom);
+	return r->status;
+}
+
+Status
+XGetWindowAttributes(Display *dpy, Window w, XWindowAttributes *wa) {
+	Rec *r;
+
+	reply();
+	if (!(r = lookup(RecAttributes, w, 0)) || !r->status)
+		return 0;
+	*wa = *(XWindowAttributes *)(r + 1);
+	wa->screen = &scr;
+	wa->visual = NULL;
+	return r->status;
+}
+
+int
+XGetWindowProperty(Display *dpy, Window w, Atom prop, long off, long len,
+		   Bool del, Atom type, Atom *actual, int *format,
+		   unsigned long *n, unsigned long *after,
+		   unsigned char **p) {
+	RecProp *rp;
+	Rec *r;
+
+	reply();
+	*actual = None;
+	*format = 0;
+	*n = *after = 0;
+	*p = NULL;
+	if (!(r = lookup(RecProperty, w, prop)))
+		return Success;
+	if (r->status != Success)
+		return r->status;
+	rp = (RecProp *)(r + 1);
+	*actual = rp->type;
+	*format = rp->format;
+	*n = rp->n;
+	*after = rp->after;
+	if (rp->type != None) {
+		*p = grow(NULL, r->len - sizeof(RecProp) + 1);
+		memcpy(*p, rp + 1, r->len - sizeof(RecProp));
+		(*p)[r->len - sizeof(RecProp)] = '\0';
+	}
+	return Success;
+}
+
+int
+XGrabButton(Display *dpy, unsigned int button, unsigned int mods,
+	    Window w, Bool owner, unsigned int mask, int pmode, int kmode,
+	    Window confine, Cursor cursor) {
+	request();
+	return 1;
+}
+
+int
+XGrabKey(Display *dpy, int code, unsigned int mods, Window w, Bool owner,
+	 int pmode, int kmode) {
+	request();
+	return 1;
+}
+
+int
+XGrabKeyboard(Display *dpy, Window w, Bool owner, int pmode, int kmode,
+	      Time time) {
+	Rec *r;
+
+	reply();
+	return (r = lookup(RecGrabKeyboard, w, 0)) ? r->status : GrabSuccess;
+}
+
+int
+XGrabPointer(Display *dpy, Window w, Bool owner, unsigned int mask,
+	     int pmode, int kmode, Window confine, Cursor cursor, Time time) {
+	Rec *r;
+
+	reply();
+	return (r = lookup(RecGrabPointer, w, 0)) ? r->status : GrabSuccess;
+}
+
+Atom
+XInternAtom(Display *dpy, _Xconst char *name, Bool onlyifexists) {
+	reply();
+	return atom(name);
+}
+
+#if NeedWidePrototypes
+KeySym
+XKeycodeToKeysym(Display *dpy, unsigned int code, int index) {
+#else
+KeySym
+XKeycodeToKeysym(Display *dpy, KeyCode code, int index) {
+#endif
+	Rec *r;
+
+	if (replaying)
+		return (r = lookup(RecKeysym, 0, code | index << 8))
+		       ? *(KeySym *)(r + 1) : NoSymbol;
+	return keysyms[code];
+}
+
+KeyCode
+XKeysymToKeycode(Display *dpy, KeySym ks) {
+	Rec *r;
+
+	if (replaying)
+		return (r = lookup(RecKeycode, 0, ks)) ? *(KeyCode *)(r + 1) : 0;
+	return keycode(ks);
+}
+
+int
+XKillClient(Display *dpy, XID resource) {
+	request();
+	return 1;
+}
+
+int
+XMapWindow(Display *dpy, Window w) {
+	request();
+	return 1;
+}
+
+int
+XMoveResizeWindow(Display *dpy, Window w, int x, int y, unsigned int width,
+		  unsigned int height) {
+	request();
+	return 1;
+}
+
+int
+XMoveWindow(Display *dpy, Window w, int x, int y) {
+	request();
+	return 1;
+}
+
+int
+XNextEvent(Display *dpy, XEvent *ev) {
+	XEvent *e;
+
+	if (!(e = pop()))
+		die("mock: XNextEvent would block forever");
+	*ev = *e;
+	return 0;
+}
+
+Display *
+XOpenDisplay(_Xconst char *name) {
+	static int fds[2];
+	_XPrivDisplay dpy;
+	const char *s;
+	int n = 200;
+
+	/* a connection that never becomes readable, run() polls it */
+	if (pipe(fds) == -1 || !(dpy = __real_calloc(1, sizeof(*dpy))))
+		return NULL;
+	dpy->fd = fds[0];
+	dpy->nscreens = 1;
+	dpy->screens = &scr;
+	scr.display = (Display *)dpy;
+	scr.root = ROOT;
+	scr.width = 1920;
+	scr.height = 1080;
+	scr.cmap = 1;
+	scr.root_depth = 24;
+	scr.root_visual = &vis;
+	vis.class = TrueColor;
+	vis.red_mask = 0xff0000;
+	vis.green_mask = 0xff00;
+	vis.blue_mask = 0xff;
+	if (!mkdtemp(home) || setenv("HOME", home, 1) == -1)
+		die("speck-mock: cannot set up HOME:");
+	if ((s = getenv("MOCK_REPLAY"))) {
+		load(s);
+	} else {
+		if ((s = getenv("MOCK_WINDOWS")))
+			n = MAX(1, atoi(s));
+		script(n);
+	}
+	phasestart = now();
+	return (Display *)dpy;
+}
+
+int
+XPending(Display *dpy) {
+	if (evhead < nev)
+		return 1;
+	if (!quitting) {
+		quitting = 1;
+		setphase(PhQuit);
+		raise(SIGTERM);
+	}
+	return 0;
+}
+
+int
+XPutImage(Display *dpy, Drawable d, GC gc, XImage *img, int sx, int sy,
+	  int dx, int dy, unsigned int w, unsigned int h) {
+	request();
+	return 1;
+}
+
+Bool
+XQueryPointer(Display *dpy, Window w, Window *root, Window *child,
+	      int *rx, int *ry, int *wx, int *wy, unsigned int *mask) {
+	RecPtr *rp;
+	Rec *r;
+
+	reply();
+	if ((r = lookup(RecPointer, w, 0))) {
+		rp = (RecPtr *)(r + 1);
+		*root = rp->root;
+		*child = rp->child;
+		*rx = rp->rx;
+		*ry = rp->ry;
+		*wx = rp->wx;
+		*wy = rp->wy;
+		*mask = rp->mask;
+		return r->status;
+	}
+	*root = scr.root;
+	*child = None;
+	*rx = *wx = ptrx;
+	*ry = *wy = ptry;
+	*mask = 0;
+	return True;
+}
+
+Status
+XQueryTree(Display *dpy, Window w, Window *root, Window *parent,
+	   Window **children, unsigned int *n) {
+	RecTreeHdr *th;
+	Rec *r;
+
+	reply();
+	*root = scr.root;
+	*parent = None;
+	*children = NULL;
+	*n = 0;
+	if (!(r = lookup(RecTree, w, 0)))
+		return 1;
+	if (!r->status)
+		return 0;
+	th = (RecTreeHdr *)(r + 1);
+	*root = th->root;
+	*parent = th->parent;
+	if ((*n = (r->len - sizeof(RecTreeHdr)) / sizeof(Window))) {
+		*children = grow(NULL, *n * sizeof(Window));
+		memcpy(*children, th + 1, *n * sizeof(Window));
+	}
+	return r->status;
+}
+
+int
+XRaiseWindow(Display *dpy, Window w) {
+	request();
+	return 1;
+}
+
+int
+XRefreshKeyboardMapping(XMappingEvent *ev) {
+	return 1;
+}
+
+#ifdef XRES
+Status
+XResQueryClientPixmapBytes(Display *dpy, XID xid, unsigned long *bytes) {
+	reply();
+	return 0;
+}
+
+Status
+XResQueryClientResources(Display *dpy, XID xid, int *n, XResType **types) {
+	reply();
+	return 0;
+}
+
+Bool
+XResQueryExtension(Display *dpy, int *eb, int *erb) {
+	reply();
+	return False;
+}
+#endif /* XRES */
+
+int
+XRestackWindows(Display *dpy, Window *w, int n) {
+	stats[phase].requests += n;
+	return 1;
+}
+
+int
+XSelectInput(Display *dpy, Window w, long mask) {
+	request();
+	return 1;
+}
+
+Status
+XSendEvent(Display *dpy, Window w, Bool propagate, long mask, XEvent *ev) {
+	request();
+	return 1;
+}
+
+XErrorHandler
+XSetErrorHandler(XErrorHandler handler) {
+	XErrorHandler old = errhandler;
+
+	errhandler = handler;
+	return old;
+}
+
+void
+XSetIOErrorExitHandler(Display *dpy, XIOErrorExitHandler handler,
+		       void *arg) {
+}
+
+int
+XSetInputFocus(Display *dpy, Window focus, int revert, Time time) {
+	request();
+	return 1;
+}
+
+int
+XSetWindowBackgroundPixmap(Display *dpy, Window w, Pixmap pm) {
+	request();
+	return 1;
+}
+
+int
+XSetWindowBorder(Display *dpy, Window w, unsigned long pixel) {
+	request();
+	return 1;
+}
+
+Bool
+XSupportsLocale(void) {
+	return True;
+}
+
+int
+XSync(Display *dpy, Bool discard) {
+	reply();
+	return 1;
+}
+
+int
+XUngrabButton(Display *dpy, unsigned int button, unsigned int mods,
+	      Window w) {
+	request();
+	return 1;
+}
+
+int
+XUngrabKey(Display *dpy, int code, unsigned int mods, Window w) {
+	request();
+	return 1;
+}
+
+int
+XUngrabKeyboard(Display *dpy, Time time) {
+	request();
+	return 1;
+}
+
+int
+XUngrabPointer(Display *dpy, Time time) {
+	request();
+	return 1;
+}
+
+int
+XUnmapWindow(Display *dpy, Window w) {
+	request();
+	return 1;
+}
+
+int
+XWarpPointer(Display *dpy, Window src, Window dst, int sx, int sy,
+	     unsigned int sw, unsigned int sh, int dx, int dy) {
+	request();
+	return 1;
+}
@@ -0,0 +1,313 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Session recorder. Linked into speck by make speck-record, it sits
+ * between speck and libX11 (see the --wrap flags in the Makefile) and
+ * writes every event speck receives and every reply it consumes to
+ * $SPECK_RECORD, speck.rec by default. MOCK_REPLAY=file ./speck-mock feeds
+ * such a recording back to speck and reports the cost of each handler.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "record.h"
+#include "util.h"
+
+static size_t propsize(int format, unsigned long n);
+static void put(unsigned int kind, unsigned long win, unsigned long arg,
+		int status, const void *a, size_t alen, const void *b,
+		size_t blen);
+
+Status __real_XGetClassHint(Display *dpy, Window w, XClassHint *ch);
+XModifierKeymap *__real_XGetModifierMapping(Display *dpy);
+Status __real_XGetTransientForHint(Display *dpy, Window w, Window *trans);
+Status __real_XGetWMClientMachine(Display *dpy, Window w, XTextProperty *tp);
+XWMHints *__real_XGetWMHints(Display *dpy, Window w);
+Status __real_XGetWMNormalHints(Display *dpy, Window w, XSizeHints *hints,
+				long *supplied);
+Status __real_XGetWMProtocols(Display *dpy, Window w, Atom **protocols,
+			      int *n);
+Status __real_XGetWindowAttributes(Display *dpy, Window w,
+				   XWindowAttributes *wa);
+int __real_XGetWindowProperty(Display *dpy, Window w, Atom prop, long off,
+			      long len, Bool del, Atom type, Atom *actual,
+			      int *format, unsigned long *n,
+			      unsigned long *after, unsigned char **p);
+int __real_XGrabKeyboard(Display *dpy, Window w, Bool owner, int pmode,
+			 int kmode, Time time);
+int __real_XGrabPointer(Display *dpy, Window w, Bool owner,
+			unsigned int mask, int pmode, int kmode,
+			Window confine, Cursor cursor, Time time);
+Atom __real_XInternAtom(Display *dpy, _Xconst char *name, Bool onlyifexists);
+#if NeedWidePrototypes
+KeySym __real_XKeycodeToKeysym(Display *dpy, unsigned int code, int index);
+#else
+KeySym __real_XKeycodeToKeysym(Display *dpy, KeyCode code, int index);
+#endif
+KeyCode __real_XKeysymToKeycode(Display *dpy, KeySym ks);
+int __real_XNextEvent(Display *dpy, XEvent *ev);
+Display *__real_XOpenDisplay(_Xconst char *name);
+Bool __real_XQueryPointer(Display *dpy, Window w, Window *root,
+			  Window *child, int *rx, int *ry, int *wx, int *wy,
+			  unsigned int *mask);
+Status __real_XQueryTree(Display *dpy, Window w, Window *root,
+			 Window *parent, Window **children, unsigned int *n);
+
+static FILE *rec;
+
+size_t
+propsize(int format, unsigned long n) {
+	switch (format) {
+	case 8:  return n;
+	case 16: return n * sizeof(short);
+	case 32: return n * sizeof(long);
+	}
+	return 0;
+}
+
+void
+put(unsigned int kind, unsigned long win, unsigned long arg, int status,
+    const void *a, size_t alen, const void *b, size_t blen) {
+	static const char pad[sizeof(long)];
+	Rec r;
+
+	if (!rec)
+		return;
+	memset(&r, 0, sizeof r);
+	r.kind = kind;
+	r.len = alen + blen;
+	r.status = status;
+	r.win = win;
+	r.arg = arg;
+	fwrite(&r, sizeof r, 1, rec);
+	if (alen)
+		fwrite(a, 1, alen, rec);
+	if (blen)
+		fwrite(b, 1, blen, rec);
+	fwrite(pad, 1, RECSIZE(r.len) - r.len, rec);
+}
+
+Status
+__wrap_XGetClassHint(Display *dpy, Window w, XClassHint *ch) {
+	Status s;
+	const char *name, *class;
+
+	s = __real_XGetClassHint(dpy, w, ch);
+	name = s && ch->res_name ? ch->res_name : "";
+	class = s && ch->res_class ? ch->res_class : "";
+	put(RecClass, w, 0, s, name, strlen(name) + 1, class,
+	    strlen(class) + 1);
+	return s;
+}
+
+XModifierKeymap *
+__wrap_XGetModifierMapping(Display *dpy) {
+	XModifierKeymap *modmap;
+
+	if ((modmap = __real_XGetModifierMapping(dpy)))
+		put(RecModmap, 0, 0, 1, &modmap->max_keypermod, sizeof(int),
+		    modmap->modifiermap, 8 * modmap->max_keypermod);
+	return modmap;
+}
+
+Status
+__wrap_XGetTransientForHint(Display *dpy, Window w, Window *trans) {
+	Status s;
+
+	s = __real_XGetTransientForHint(dpy, w, trans);
+	put(RecTransient, w, 0, s, trans, s ? sizeof(Window) : 0, NULL, 0);
+	return s;
+}
+
+Status
+__wrap_XGetWMClientMachine(Display *dpy, Window w, XTextProperty *tp) {
+	Status s;
+
+	s = __real_XGetWMClientMachine(dpy, w, tp);
+	if (s)
+		put(RecMachine, w, 0, s, tp, sizeof(XTextProperty), tp->value,
+		    propsize(tp->format, tp->nitems));
+	else
+		put(RecMachine, w, 0, s, NULL, 0, NULL, 0);
+	return s;
+}
+
+XWMHints *
+__wrap_XGetWMHints(Display *dpy, Window w) {
+	XWMHints *wmh;
+
+	wmh = __real_XGetWMHints(dpy, w);
+	put(RecWMHints, w, 0, wmh != NULL, wmh, wmh ? sizeof(XWMHints) : 0,
+	    NULL, 0);
+	return wmh;
+}
+
+Status
+__wrap_XGetWMNormalHints(Display *dpy, Window w, XSizeHints *hints,
+			 long *supplied) {
+	Status s;
+
+	s = __real_XGetWMNormalHints(dpy, w, hints, supplied);
+	put(RecNormalHints, w, s ? *supplied : 0, s, hints,
+	    s ? sizeof(XSizeHints) : 0, NULL, 0);
+	return s;
+}
+
+Status
+__wrap_XGetWMProtocols(Display *dpy, Window w, Atom **protocols, int *n) {
+	Status s;
+
+	s = __real_XGetWMProtocols(dpy, w, protocols, n);
+	put(RecProtocols, w, 0, s, s ? *protocols : NULL,
+	    s ? *n * sizeof(Atom) : 0, NULL, 0);
+	return s;
+}
+
+Status
+__wrap_XGetWindowAttributes(Display *dpy, Window w, XWindowAttributes *wa) {
+	Status s;
+
+	s = __real_XGetWindowAttributes(dpy, w, wa);
+	put(RecAttributes, w, 0, s, wa, s ? sizeof(XWindowAttributes) : 0,
+	    NULL, 0);
+	return s;
+}
+
+int
+__wrap_XGetWindowProperty(Display *dpy, Window w, Atom prop, long off,
+			  long len, Bool del, Atom type, Atom *actual,
+			  int *format, unsigned long *n,
+			  unsigned long *after, unsigned char **p) {
+	RecProp rp = { 0 };
+	int s;
+
+	s = __real_XGetWindowProperty(dpy, w, prop, off, len, del, type, actual,
+				      format, n, after, p);
+	if (s == Success) {
+		rp.type = *actual;
+		rp.format = *format;
+		rp.n = *n;
+		rp.after = *after;
+	}
+	put(RecProperty, w, prop, s, &rp, sizeof rp, s == Success ? *p : NULL,
+	    s == Success && *p ? propsize(rp.format, rp.n) : 0);
+	return s;
+}
+
+int
+__wrap_XGrabKeyboard(Display *dpy, Window w, Bool owner, int pmode,
+		     int kmode, Time time) {
+	int s;
+
+	s = __real_XGrabKeyboard(dpy, w, owner, pmode, kmode, time);
+	put(RecGrabKeyboard, w, 0, s, NULL, 0, NULL, 0);
+	return s;
+}
+
+int
+__wrap_XGrabPointer(Display *dpy, Window w, Bool owner, unsigned int mask,
+		    int pmode, int kmode, Window confine, Cursor cursor,
+		    Time time) {
+	int s;
+
+	s = __real_XGrabPointer(dpy, w, owner, mask, pmode, kmode, confine,
+				cursor, time);
+	put(RecGrabPointer, w, 0, s, NULL, 0, NULL, 0);
+	return s;
+}
+
+Atom
+__wrap_XInternAtom(Display *dpy, _Xconst char *name, Bool onlyifexists) {
+	Atom a;
+
+	a = __real_XInternAtom(dpy, name, onlyifexists);
+	put(RecAtom, 0, a, 1, name, strlen(name) + 1, NULL, 0);
+	return a;
+}
+
+#if NeedWidePrototypes
+KeySym
+__wrap_XKeycodeToKeysym(Display *dpy, unsigned int code, int index) {
+#else
+KeySym
+__wrap_XKeycodeToKeysym(Display *dpy, KeyCode code, int index) {
+#endif
+	KeySym ks;
+
+	ks = __real_XKeycodeToKeysym(dpy, code, index);
+	put(RecKeysym, 0, code | index << 8, 1, &ks, sizeof ks, NULL, 0);
+	return ks;
+}
+
+KeyCode
+__wrap_XKeysymToKeycode(Display *dpy, KeySym ks) {
+	KeyCode code;
+
+	code = __real_XKeysymToKeycode(dpy, ks);
+	put(RecKeycode, 0, ks, 1, &code, sizeof code, NULL, 0);
+	return code;
+}
+
+int
+__wrap_XNextEvent(Display *dpy, XEvent *ev) {
+	int r;
+
+	r = __real_XNextEvent(dpy, ev);
+	put(RecEvent, 0, 0, r, ev, sizeof(XEvent), NULL, 0);
+	return r;
+}
+
+Display *
+__wrap_XOpenDisplay(_Xconst char *name) {
+	Display *dpy;
+	RecScreen rs;
+	const char *path;
+
+	if (!(path = getenv("SPECK_RECORD")))
+		path = "speck.rec";
+	if (!(rec = fopen(path, "w")))
+		die("speck: cannot open %s:", path);
+	if (!(dpy = __real_XOpenDisplay(name)))
+		return NULL;
+	rs.width = DisplayWidth(dpy, DefaultScreen(dpy));
+	rs.height = DisplayHeight(dpy, DefaultScreen(dpy));
+	put(RecDisplay, RootWindow(dpy, DefaultScreen(dpy)), 0, 1, &rs,
+	    sizeof rs, NULL, 0);
+	return dpy;
+}
+
+Bool
+__wrap_XQueryPointer(Display *dpy, Window w, Window *root, Window *child,
+		     int *rx, int *ry, int *wx, int *wy, unsigned int *mask) {
+	RecPtr rp;
+	Bool r;
+
+	r = __real_XQueryPointer(dpy, w, root, child, rx, ry, wx, wy, mask);
+	rp.root = *root;
+	rp.child = *child;
+	rp.rx = *rx;
+	rp.ry = *ry;
+	rp.wx = *wx;
+	rp.wy = *wy;
+	rp.mask = *mask;
+	put(RecPointer, w, 0, r, &rp, sizeof rp, NULL, 0);
+	return r;
+}
+
+Status
+__wrap_XQueryTree(Display *dpy, Window w, Window *root, Window *parent,
+		  Window **children, unsigned int *n) {
+	RecTreeHdr th = { 0 };
+	Status s;
+
+	s = __real_XQueryTree(dpy, w, root, parent, children, n);
+	if (s) {
+		th.root = *root;
+		th.parent = *parent;
+	}
+	put(RecTree, w, 0, s, &th, sizeof th, s ? *children : NULL,
+	    s ? *n * sizeof(Window) : 0);
+	return s;
+}
@@ -0,0 +1,43 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Session recordings, written by record.c and replayed by mock.c. A
+ * recording is a sequence of Rec headers, each followed by len bytes of
+ * data padded to RECSIZE(len). Everything is stored in host layout, so a
+ * recording only replays on the architecture it was made on.
+ */
+#define RECSIZE(len)            (((len) + sizeof(long) - 1) / sizeof(long) * sizeof(long))
+
+enum { RecDisplay, RecEvent, RecAtom, RecAttributes, RecTransient, RecClass,
+       RecProperty, RecWMHints, RecNormalHints, RecProtocols, RecMachine,
+       RecTree, RecPointer, RecGrabPointer, RecGrabKeyboard, RecKeysym,
+       RecKeycode, RecModmap, RecLast }; /* record kinds */
+
+typedef struct {
+	unsigned int kind, len;
+	int status;             /* return value of the call */
+	unsigned long win, arg; /* what the reply is for */
+} Rec;
+
+/* data of RecDisplay, win is the root window */
+typedef struct {
+	int width, height;
+} RecScreen;
+
+/* data of RecProperty, followed by the property value */
+typedef struct {
+	Atom type;
+	int format;
+	unsigned long n, after;
+} RecProp;
+
+/* data of RecTree, followed by the children */
+typedef struct {
+	Window root, parent;
+} RecTreeHdr;
+
+/* data of RecPointer */
+typedef struct {
+	Window root, child;
+	int rx, ry, wx, wy;
+	unsigned int mask;
+} RecPtr;
@@ -1,12 +1,24 @@
 /* See LICENSE file for copyright and license details. */
 #include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <X11/keysym.h>
@@ -14,6 +26,12 @@
 #include <X11/Xlib.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#ifdef PNG
+#include <png.h>
+#endif /* PNG */
+#ifdef XRES
+#include <X11/extensions/XRes.h>
+#endif /* XRES */
 
 #include "util.h"
 
@@ -22,18 +40,37 @@
 #define CLEANMASK(mask)         (mask & ~(numlockmask|LockMask) & \
 				 (ShiftMask|ControlMask|Mod1Mask|Mod2Mask \
 				  |Mod3Mask|Mod4Mask|Mod5Mask))
-#define ISVISIBLE(C)            (((C)->tag == themon->tagset[themon->seltag]))
+#define ISVISIBLE(C)            ((C)->tags & themon->tagset[themon->seltag])
+#define OVERLAP(A, B)           ((A).x < (B).x + (B).w \
+				 && (B).x < (A).x + (A).w \
+				 && (A).y < (B).y + (B).h \
+				 && (B).y < (A).y + (A).h)
 #define LENGTH(X)               (sizeof X / sizeof X[0])
+#define MAXTAGS                 (sizeof(unsigned int) * 8)
+#define TAGMASK                 ((unsigned int)(~0ULL >> (64 - numtags)))
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
 #define WIDTH(X)                ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X)               ((X)->h + 2 * (X)->bw)
+#define GEOMMAGIC               0x73706b67656f6d32ULL /* "spkgeom2" */
+#define GEOMPROBE               8
+#define BGMAGIC                 0x73706b6267696d31ULL /* "spkbgim1" */
+#ifndef POSIX_SPAWN_SETSID /* not in older POSIX, a new group will do */
+#define POSIX_SPAWN_SETSID      POSIX_SPAWN_SETPGROUP
+#endif
 
 /* enums */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms */
-enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
+       NetWMWindowTypeDialog, NetClientList, NetWMPing, NetWMPid,
+       NetWMBypassCompositor, NetClientListStacking, NetStartupId,
+       NetLast }; /* EWMH atoms */
+enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMWindowRole,
+       WMLast }; /* default atoms */
 enum { ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { TmPing, TmPool, TmFreeze, TmRate, TmSample, TmLast }; /* timers */
+enum { RlConfigure, RlProperty, RlFocus, RlLast }; /* rate limits */
+enum { DfConfigure = 1, DfHints = 2, DfType = 4,
+       DfTransient = 8 }; /* deferred work */
 
 typedef union {
 	int i;
@@ -59,9 +96,35 @@ struct Client {
 	int oldx, oldy, oldw, oldh;
 	int basew, baseh, incw, inch, maxw, maxh, minw, minh, hintsvalid;
 	int bw, oldbw; /* border width */
-	unsigned int tag;
-	int isfixed, neverfocus, isfullscreen;
+	unsigned int tags;
+	int isfixed, isfloating, neverfocus, isfullscreen;
+	int hasxy; /* positioned by the user or the geometry memory */
+	int occluded; /* unmapped below a fullscreen client */
+	int carved; /* cut out of the free space index */
+	int ignoreunmap; /* UnmapNotifys caused by speck */
+	long bypass; /* _NET_WM_BYPASS_COMPOSITOR as set by the client */
+	float tokens[RlLast]; /* rate limit buckets */
+	long spent[RlLast]; /* ms of the last refill */
+	unsigned int strikes, quarantined;
+	unsigned int deferred; /* Df* held back by the rate limits */
+	XConfigureRequestEvent cfgreq; /* merged while DfConfigure */
+	pid_t pid; /* only set for local clients */
+	unsigned int pool; /* index + 1 into pools while held back */
+	int freeze, isfrozen; /* SIGSTOP the process while hidden */
+	long hiddenat; /* ms, 0 while visible */
+	long pingsent; /* ms, 0 if no _NET_WM_PING is outstanding */
+	long cputicks, sampledat; /* utime + stime at the last sample, in ms */
+	unsigned int cpu; /* permille of a CPU between the last two samples */
+	long rss; /* kB */
+	long pixmaps; /* kB held by its X connection, with XRes */
+	unsigned int windows; /* of its X connection, with XRes */
+	uint64_t geomkey; /* geometry memory entry, 0 if not remembered */
+	Client *parent; /* WM_TRANSIENT_FOR, if managed */
+	Client *kids, *sib, *sibprev; /* transients, most recent first */
+	Client *next;
 	Client *snext; /* stack next */
+	Client *tnext[MAXTAGS], *tprev[MAXTAGS]; /* per-tag MRU rings */
+	unsigned long mruseq; /* when it last went to the head of its rings */
 	Window win;
 };
 
@@ -72,84 +135,280 @@ typedef struct {
 	const Arg arg;
 } Key;
 
+typedef struct {
+	const char *symbol;
+	void (*arrange)(Monitor *);
+} Layout;
+
+typedef struct {
+	int x, y, w, h;
+} Rect;
+
+typedef struct {
+	int v; /* position on its axis */
+	int lo, hi; /* extent on the other axis */
+} Edge;
+
 struct Monitor {
 	int mw, mh;   /* screen size */
 	unsigned int seltag;
 	unsigned int tagset[2]; /* There are two for toggling like Alt-Tab */
+	Client *clients;
 	Client *sel;
 	Client *stack;
+	Client *fullscreen; /* the one occluding the rest of its tags */
+	Client **tagmru; /* MRU ring heads, indexed by tag bit */
+	const Layout **lt; /* indexed by the lowest tag of the view */
+	Window *stacking, *stackbuf; /* top to bottom as last sent */
+	unsigned int nstacking, stackcap;
+	Rect *space; /* maximal empty rectangles of the view */
+	Rect *spacebuf, *spacenew; /* scratch for carve() and uncarve() */
+	unsigned int nspace, spacecap;
+	int spacevalid; /* 0 until rebuilt after a view change or layout */
+	int cascadeat; /* offset of the next window that fits nowhere */
 };
 
 typedef struct {
 	const char *class;
 	const char *instance;
 	const char *title;
-	unsigned int tag;
+	unsigned int tags;
+	int freeze;
 } Rule;
 
+typedef struct {
+	const char **cmd;
+	unsigned int n;
+} Pool;
+
+typedef struct {
+	pid_t pid; /* 0 once a spawn() child has exited */
+	unsigned int pool; /* index + 1 into pools, 0 for spawn() */
+	unsigned int tags; /* view it was launched from */
+	unsigned long id; /* in its startup id */
+	long at; /* ms, 0 if the slot is free */
+} Launch;
+
+/* a pointer or keyboard grab in progress, run() hands its events to func
+ * first. func returns 0 for events it leaves to the handlers and ends the
+ * grab when it sees its last event or NULL */
+typedef struct {
+	int (*func)(XEvent *e); /* NULL without a grab */
+	Client *c;
+	int px, py; /* pointer at the start */
+	int ox, oy; /* client at the start */
+	int x, y, w, h; /* outline or new geometry */
+	int dir; /* focusmru() direction */
+	Time lasttime; /* of the last motion handled */
+} Grab;
+
+/* A display of the farm. The globals dwm had, dpy to numlockmask, are
+ * swapped in by useseat(), the rest is used through seat */
+typedef struct {
+	const char *name; /* NULL for $DISPLAY */
+	Display *dpy;
+	Monitor *themon;
+	Window root, wmcheckwin;
+	int screen, sw, sh;
+	unsigned int numlockmask;
+	Atom wmatom[WMLast], netatom[NetLast];
+	int lost; /* the connection broke, dropped by run() */
+	int timerfd;
+	long timers[TmLast]; /* deadlines in ms, 0 if unarmed */
+	int focusdeferred; /* a focus fight is being sat out */
+	Atom usageatom, rootpmapatom, esetrootatom;
+	Pixmap bgpixmap; /* root background, None if not set by speck */
+	long *usage; /* _SPECK_USAGE as last published */
+	unsigned int usagecap, nusage;
+	unsigned int sampleat; /* first client of the next sampling batch */
+	int hasxres; /* the server has the X-Resource extension */
+	Atom reswinatom; /* its resource type for windows */
+	Launch launches[64]; /* launched programs that have not mapped yet */
+	unsigned int cgtags; /* tags whose cgroups have the boosted weights */
+	XColor focusbordercolor, unfocusbordercolor;
+	GC outlinegc;
+	Grab grab; /* of the drag or MRU cycle going on */
+	Edge *snapx, *snapy; /* sorted edges of the other visible clients */
+	unsigned int snapcap, nsnap;
+	long spawnlast, spawnmax; /* posix_spawnp() latency in us */
+	long placelast, placemax; /* place() latency in us */
+	long samplelast, samplemax; /* sampleclients() cost in us */
+} Seat;
+
+/* geometry memory file, a GeomHdr followed by n Geoms */
+typedef struct {
+	uint64_t magic;
+	uint32_t n, pad;
+} GeomHdr;
+
+/* background cache file, a BgHdr followed by w * h pixels */
+typedef struct {
+	uint64_t magic;
+	int64_t mtime, size; /* of the PNG it was scaled from */
+	uint32_t w, h;
+} BgHdr;
+
+typedef struct {
+	uint64_t key; /* hash of class, instance and role, 0 if free */
+	int64_t used; /* time of the last save, the oldest is evicted */
+	int32_t x, y, w, h; /* w is 0 if only the tags are known */
+	uint32_t tags, pad;
+} Geom;
+
 /* function declarations */
+static Client *allocclient(void);
 static void applyrules(Client *c);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h);
+static void armtimers(void);
 static void arrange(int dorestack);
+static void arrangemon(int dorestack);
+static void attach(Client *c);
 static void attachstack(Client *c);
+static void attachtag(Client *c);
+static void buildsnap(Client *c);
+static void buildspace(void);
 static void buttonpress(XEvent *e);
+static void carve(Client *c);
+static void cgpath(char *buf, size_t size, unsigned int tag, const char *file);
+static void cgplace(pid_t pid, unsigned int tags);
+static void cgsetup(void);
+static void cgview(void);
+static void cgweigh(unsigned int tag, unsigned int weight);
+static int cgwrite(unsigned int tag, const char *file, const char *val);
 static void checkotherwm(void);
+static void checkpings(void);
 static void cleanup(void);
+static void cleanupseat(void);
 static void clientmessage(XEvent *e);
+static pid_t clientpid(Client *c);
 static void configure(Client *c);
+static void configureclient(Client *c, XConfigureRequestEvent *ev);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
+static unsigned int cut(Rect *s, unsigned int n, Rect r, const Rect *clip);
 static void destroynotify(XEvent *e);
+static void detach(Client *c);
 static void detachstack(Client *c);
+static void detachtag(Client *c);
+static void drawoutline(Client *c, int x, int y, int w, int h);
+static void dropseat(void);
+static void dumpstate(void);
+static int edgecmp(const void *a, const void *b);
+static void fillpools(void);
+static Launch *findlaunch(Client *c);
 static void focus(Client *c);
+static void freezeclients(void);
 static void focusin(XEvent *e);
+static void focusmru(const Arg *arg);
 static void focusstack(const Arg *arg);
+static void flushdeferred(void);
+static void freeclient(Client *c);
 static Atom getatomprop(Client *c, Atom prop);
+static long getcardprop(Client *c, Atom prop);
+static Geom *getgeom(uint64_t key, int create);
 static int getrootptr(int *x, int *y);
 static long getstate(Window w);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
+static void grid(Monitor *m);
+static void growspace(unsigned int n);
+static void handlesignals(void);
+static void hideclient(Client *c);
 static void keypress(XEvent *e);
 static void killclient(const Arg *arg);
+static void killgroup(Client *c, int kid);
+static void killhung(Client *c);
+static void killwin(Client *c);
+static pid_t launch(const char **argv, unsigned int pool);
+static void loadgeom(Client *c, const char *class, const char *instance);
 static void manage(Window w, XWindowAttributes *wa);
 static void mappingnotify(XEvent *e);
+static Client *nexttiled(Client *c);
+static int mrugrab(XEvent *e);
+static Client *mrustep(Client *c, int dir);
+static long now(void);
 static void maprequest(XEvent *e);
 static void maximize(const Arg *arg);
 static void minimize(const Arg *arg);
+static int movegrab(XEvent *e);
 static void movemouse(const Arg *arg);
+static void occlude(Client *c);
+static void opengeom(void);
+static int overbudget(Client *c, int r);
+static void place(Client *c);
+static void previewmru(void);
+static int procstat(pid_t pid, long *ticks, long *rss);
 static void propertynotify(XEvent *e);
 static void quit(const Arg *arg);
 static void resize(Client *c, int x, int y, int w, int h);
 static void resizeclient(Client *c, int x, int y, int w, int h);
+static int resizegrab(XEvent *e);
 static void resizemouse(const Arg *arg);
 static void restack(Monitor *m);
 static void run(void);
+static void savegeom(Client *c);
+#ifdef PNG
+static void scalebg(const uint32_t *src, int w, int h, uint32_t *dst,
+		    int dw, int dh);
+#endif /* PNG */
+static void runtimers(void);
+static void sampleclients(void);
 static void scan(void);
+static int nearestedge(const Edge *e, unsigned int n, int v, int lo, int hi);
+static const char *seatkey(void);
 static int sendevent(Client *c, Atom proto);
+static void setbackground(void);
 static void setclientstate(Client *c, long state);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
+static void setlayout(const Arg *arg);
+static void setparent(Client *c, Client *p);
+static void setrealtime(void);
+static void settags(Client *c, unsigned int tags);
+static void settimer(int t, long ms);
 static void setup(void);
-static void showhide(Client *c);
-static void sigchld(int unused);
+static void setupseat(void);
+static void showclient(Client *c);
+static void showhide(void);
+static void showhidetags(unsigned int old);
+static Window *stackfamily(Client *c, Window *w);
+static int snapaxis(const Edge *e, unsigned int n, int v, int len, int lo,
+		    int hi);
 static void spawn(const Arg *arg);
+static unsigned int takelaunch(pid_t pid);
 static void tag(const Arg *arg);
+static void taggroup(unsigned int tags);
+static void thaw(Client *c);
+static void tile(Monitor *m);
+static void togglefloating(const Arg *arg);
+static void toggletag(const Arg *arg);
+static void toggleview(const Arg *arg);
+static void uncarve(Client *c);
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
+static void unocclude(void);
 static void unmapnotify(XEvent *e);
 static void updateclientlist(void);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
+static void updatetransient(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
+static void useseat(Seat *s);
 static void view(const Arg *arg);
+static Client *viewmru(void);
 static Client *wintoclient(Window w);
+#ifdef XRES
+static void xresstat(Client *c);
+#endif /* XRES */
 static int xerror(Display *dpy, XErrorEvent *ee);
 static int xerrordummy(Display *dpy, XErrorEvent *ee);
 static int xerrorstart(Display *dpy, XErrorEvent *ee);
+static void xioerror(Display *dpy, void *arg);
 
 /* variables */
+extern char **environ;
 static const char broken[] = "broken";
 static int screen;
 static int sw, sh;           /* X display screen geometry width, height */
@@ -168,17 +427,47 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 	[PropertyNotify] = propertynotify,
 	[UnmapNotify] = unmapnotify
 };
-static Atom wmatom[WMLast], netatom[NetLast];
+static Atom *wmatom, *netatom;
 static int running = 1;
 static Display *dpy;
 static Monitor *themon;
-static Window root, wmcheckwin;
-static XColor focusbordercolor, unfocusbordercolor, dummy;
+static Window root;
+static Client *arena, *freeclients; /* realtime client storage */
+static int sigfd;
+static unsigned long launchseq; /* last Launch.id handed out */
+static unsigned long mruseq; /* last Client.mruseq handed out */
+static GeomHdr *geomhdr; /* mapped geometry memory, NULL if disabled */
+static Geom *geoms;
+static void (*timerfunc[TmLast]) (void) = {
+	[TmPing] = checkpings,
+	[TmPool] = fillpools,
+	[TmFreeze] = freezeclients,
+	[TmRate] = flushdeferred,
+	[TmSample] = sampleclients
+};
+static XColor dummy;
+static Seat *seats, *seat; /* all displays and the one in use */
+static unsigned int nseats;
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
 
 /* function implementations */
+Client *
+allocclient(void) {
+	Client *c;
+
+	if (!(c = freeclients)) {
+		if (arena)
+			fprintf(stderr, "speck: more than %u clients, using the "
+				"heap\n", maxclients);
+		return ecalloc(1, sizeof(Client));
+	}
+	freeclients = c->next;
+	memset(c, 0, sizeof(Client));
+	return c;
+}
+
 void
 applyrules(Client *c) {
 	const char *class, *instance;
@@ -187,7 +476,7 @@ applyrules(Client *c) {
 	XClassHint ch = { NULL, NULL };
 
 	/* rule matching */
-	c->tag = 0;
+	c->tags = 0;
 	XGetClassHint(dpy, c->win, &ch);
 	class    = ch.res_class ? ch.res_class : broken;
 	instance = ch.res_name  ? ch.res_name  : broken;
@@ -196,15 +485,18 @@ applyrules(Client *c) {
 		r = &rules[i];
 		if ((!r->title || strstr(c->name, r->title))
 		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
-			c->tag = r->tag; /* last rule wins */
+		&& (!r->instance || strstr(instance, r->instance))) {
+			c->tags = r->tags & TAGMASK; /* last rule wins */
+			c->freeze = r->freeze;
+		}
 	}
+	loadgeom(c, class, instance);
 	if (ch.res_class)
 		XFree(ch.res_class);
 	if (ch.res_name)
 		XFree(ch.res_name);
-	if (c->tag == 0)
-		c->tag = themon->tagset[themon->seltag];
+	if (!c->tags)
+		c->tags = themon->tagset[themon->seltag];
 }
 
 int
@@ -258,20 +550,135 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h) {
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
+/* program the timerfd for the earliest armed timer */
+void
+armtimers(void) {
+	struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+	long next = 0;
+	int i;
+
+	for (i = 0; i < TmLast; i++)
+		if (seat->timers[i] && (!next || seat->timers[i] < next))
+			next = seat->timers[i];
+	its.it_value.tv_sec = next / 1000;
+	its.it_value.tv_nsec = next % 1000 * 1000000;
+	timerfd_settime(seat->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
 void
 arrange(int dorestack) {
-	showhide(themon->stack);
+	showhide();
+	arrangemon(dorestack);
+}
+
+/* everything arrange() does once clients are shown or hidden */
+void
+arrangemon(int dorestack) {
+	const Layout *lt = themon->lt[ffs(themon->tagset[themon->seltag])];
+
+	/* what a fullscreen client out of view covered is in view again */
+	if (themon->fullscreen && !ISVISIBLE(themon->fullscreen))
+		unocclude();
+	/* nothing to lay out or stack below a fullscreen client */
+	if (themon->fullscreen && ISVISIBLE(themon->fullscreen))
+		return;
+	if (lt->arrange) { /* moves too much to follow in the index */
+		themon->spacevalid = 0;
+		lt->arrange(themon);
+	}
 	if (dorestack) {
 		restack(themon);
 	}
 }
 
+void
+attach(Client *c) {
+	c->next = themon->clients;
+	themon->clients = c;
+}
+
 void
 attachstack(Client *c) {
 	c->snext = themon->stack;
 	themon->stack = c;
 }
 
+void
+attachtag(Client *c) {
+	Client **head;
+	unsigned int t, i;
+
+	for (t = c->tags; t; t &= t - 1) {
+		i = ffs(t) - 1;
+		head = &themon->tagmru[i];
+		if (*head) {
+			c->tnext[i] = *head;
+			c->tprev[i] = (*head)->tprev[i];
+			c->tprev[i]->tnext[i] = c;
+			(*head)->tprev[i] = c;
+		} else
+			c->tnext[i] = c->tprev[i] = c;
+		*head = c;
+	}
+	c->mruseq = ++mruseq;
+}
+
+/* index the edges of all other visible clients and the screen for snapping,
+ * built once per drag so that each motion step is a binary search and a
+ * look at the edges within snap */
+void
+buildsnap(Client *c) {
+	Client *t;
+	Edge *x, *y;
+	unsigned int n = 2;
+
+	for (t = themon->stack; t; t = t->snext)
+		if (t != c && ISVISIBLE(t))
+			n += 2;
+	if (n > seat->snapcap) { /* kept between drags */
+		seat->snapcap = MAX(n, 2 * seat->snapcap);
+		free(seat->snapx);
+		free(seat->snapy);
+		seat->snapx = ecalloc(seat->snapcap, sizeof(Edge));
+		seat->snapy = ecalloc(seat->snapcap, sizeof(Edge));
+	}
+	x = seat->snapx;
+	y = seat->snapy;
+	x[0] = (Edge){ 0, 0, themon->mh };
+	x[1] = (Edge){ themon->mw, 0, themon->mh };
+	y[0] = (Edge){ 0, 0, themon->mw };
+	y[1] = (Edge){ themon->mh, 0, themon->mw };
+	for (n = 2, t = themon->stack; t; t = t->snext)
+		if (t != c && ISVISIBLE(t)) {
+			x[n] = (Edge){ t->x, t->y, t->y + HEIGHT(t) };
+			y[n++] = (Edge){ t->y, t->x, t->x + WIDTH(t) };
+			x[n] = (Edge){ t->x + WIDTH(t), t->y, t->y + HEIGHT(t) };
+			y[n++] = (Edge){ t->y + HEIGHT(t), t->x, t->x + WIDTH(t) };
+		}
+	seat->nsnap = n;
+	qsort(x, n, sizeof(Edge), edgecmp);
+	qsort(y, n, sizeof(Edge), edgecmp);
+}
+
+/* the free space index of the view from scratch, needed after a view
+ * change or a layout moved many clients at once */
+void
+buildspace(void) {
+	Client *c;
+
+	growspace(1);
+	themon->space[0].x = themon->space[0].y = 0;
+	themon->space[0].w = themon->mw;
+	themon->space[0].h = themon->mh;
+	themon->nspace = 1;
+	themon->spacevalid = 1;
+	for (c = themon->stack; c; c = c->snext)
+		c->carved = 0;
+	for (c = themon->stack; c; c = c->snext)
+		if (ISVISIBLE(c))
+			carve(c);
+}
+
 void
 buttonpress(XEvent *e) {
 	unsigned int i, click;
@@ -293,6 +700,102 @@ buttonpress(XEvent *e) {
 			buttons[i].func(&buttons[i].arg);
 }
 
+/* takes the area of c out of the free space index, if that is valid */
+void
+carve(Client *c) {
+	Rect r = { c->x, c->y, WIDTH(c), HEIGHT(c) };
+
+	if (!themon->spacevalid || c->carved)
+		return;
+	c->carved = 1;
+	growspace(5 * themon->nspace);
+	themon->nspace = cut(themon->space, themon->nspace, r, NULL);
+}
+
+/* path of file in the cgroup of tag, or in cgroupdir for tag 0; each
+ * display of a farm gets its own groups */
+void
+cgpath(char *buf, size_t size, unsigned int tag, const char *file) {
+	const char *key = seatkey();
+
+	if (tag)
+		snprintf(buf, size, "%s/%s%stag%u/%s", cgroupdir, key,
+			 key[0] ? "-" : "", tag, file);
+	else
+		snprintf(buf, size, "%s/%s", cgroupdir, file);
+}
+
+/* move a process into the cgroup of its lowest tag */
+void
+cgplace(pid_t pid, unsigned int tags) {
+	char buf[16];
+
+	if (!cgroupdir[0] || pid <= 0 || !tags)
+		return;
+	snprintf(buf, sizeof buf, "%d", (int)pid);
+	cgwrite(ffs(tags), "cgroup.procs", buf); /* a process has one group */
+}
+
+/* one child group per tag below the delegated cgroupdir */
+void
+cgsetup(void) {
+	char path[512];
+	unsigned int i;
+
+	if (!cgroupdir[0])
+		return;
+	cgwrite(0, "cgroup.subtree_control", "+cpu");
+	cgwrite(0, "cgroup.subtree_control", "+io");
+	for (i = 1; i <= numtags; i++) {
+		cgpath(path, sizeof path, i, "");
+		if (mkdir(path, 0755) == -1 && errno != EEXIST)
+			fprintf(stderr, "speck: mkdir %s: %s\n", path,
+				strerror(errno));
+		cgweigh(i, cgweight);
+	}
+	cgview();
+}
+
+/* move the boosted weights to the cgroups of the visible tags, touching
+ * only those that came into or went out of view */
+void
+cgview(void) {
+	unsigned int i, d, t = themon->tagset[themon->seltag];
+
+	if (!cgroupdir[0])
+		return;
+	for (d = t ^ seat->cgtags; d; d &= d - 1) {
+		i = ffs(d);
+		cgweigh(i, t & 1 << (i - 1) ? cgboost : cgweight);
+	}
+	seat->cgtags = t;
+}
+
+/* set cpu.weight and io.weight of the cgroup of tag */
+void
+cgweigh(unsigned int tag, unsigned int weight) {
+	char buf[32];
+
+	snprintf(buf, sizeof buf, "%u", weight);
+	cgwrite(tag, "cpu.weight", buf);
+	snprintf(buf, sizeof buf, "default %u", weight);
+	cgwrite(tag, "io.weight", buf);
+}
+
+/* write val to file in the cgroup of tag */
+int
+cgwrite(unsigned int tag, const char *file, const char *val) {
+	char path[512];
+	int fd, ret;
+
+	cgpath(path, sizeof path, tag, file);
+	if ((fd = open(path, O_WRONLY|O_CLOEXEC)) == -1)
+		return -1;
+	ret = write(fd, val, strlen(val)) == -1 ? -1 : 0;
+	close(fd);
+	return ret;
+}
+
 void
 checkotherwm(void) {
 	xerrorxlib = XSetErrorHandler(xerrorstart);
@@ -303,28 +806,86 @@ checkotherwm(void) {
 	XSync(dpy, False);
 }
 
+/* kill clients that left a _NET_WM_PING unanswered for pingtimeout ms */
+void
+checkpings(void) {
+	Client *c;
+	long t = now();
+
+	for (c = themon->clients; c; c = c->next) {
+		if (!c->pingsent)
+			continue;
+		if (t - c->pingsent >= pingtimeout)
+			killhung(c);
+		else
+			settimer(TmPing, c->pingsent + pingtimeout - t);
+	}
+}
+
+/* what is left once every display is closed */
 void
 cleanup(void) {
+	close(sigfd);
+	free(arena);
+	if (geomhdr)
+		munmap(geomhdr, sizeof(GeomHdr) + geomhdr->n * sizeof(Geom));
+	free(seats);
+}
+
+void
+cleanupseat(void) {
 	Client *c;
 
-	for (c = themon->stack; c != NULL; c = c->snext)
-		c->tag = themon->seltag;
+	/* make every client visible so none is left off-screen */
+	for (c = themon->stack; c != NULL; c = c->snext) {
+		if (c->pool) /* nobody asked for these */
+			kill(c->pid, SIGTERM);
+		savegeom(c); /* before the tags are lost */
+		c->geomkey = 0;
+		detachtag(c);
+		c->tags = themon->tagset[themon->seltag];
+		attachtag(c);
+	}
 	while (themon->stack)
 		unmanage(themon->stack, 0);
 	XUngrabKey(dpy, AnyKey, AnyModifier, root);
+	XFreeGC(dpy, seat->outlinegc);
+	close(seat->timerfd);
+	free(themon->tagmru);
+	free(themon->lt);
+	free(themon->stacking);
+	free(themon->stackbuf);
+	free(themon->space);
+	free(themon->spacebuf);
+	free(seat->usage);
+	free(seat->snapx);
+	free(seat->snapy);
 	free(themon);
-	XDestroyWindow(dpy, wmcheckwin);
+	XDestroyWindow(dpy, seat->wmcheckwin);
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
+	XDeleteProperty(dpy, root, seat->usageatom);
+	if (seat->bgpixmap) { /* the background stays, the pixmap goes */
+		XDeleteProperty(dpy, root, seat->rootpmapatom);
+		XDeleteProperty(dpy, root, seat->esetrootatom);
+		XFreePixmap(dpy, seat->bgpixmap);
+	}
 }
 
 void
 clientmessage(XEvent *e) {
 	XClientMessageEvent *cme = &e->xclient;
-	Client *c = wintoclient(cme->window);
+	Client *c;
 
-	if (!c)
+	if (cme->window == root && cme->message_type == wmatom[WMProtocols]
+	&& (Atom)cme->data.l[0] == netatom[NetWMPing]) {
+		/* pong, data.l[2] names the client window */
+		if ((c = wintoclient(cme->data.l[2])))
+			c->pingsent = 0;
+		return;
+	}
+	if (!(c = wintoclient(cme->window)))
 		return;
 	if (cme->message_type == netatom[NetWMState]) 
 		if (cme->data.l[1] == netatom[NetWMFullscreen]
@@ -335,6 +896,36 @@ clientmessage(XEvent *e) {
 			    && !c->isfullscreen)));
 }
 
+pid_t
+clientpid(Client *c) {
+	int di;
+	unsigned long dl;
+	unsigned char *p = NULL;
+	char host[256];
+	pid_t pid = 0;
+	Atom da;
+	XTextProperty tp;
+
+	if (XGetWindowProperty(dpy, c->win, netatom[NetWMPid], 0L, 1L, False,
+		XA_CARDINAL, &da, &di, &dl, &dl, &p) == Success && p) {
+		pid = *(long *)p;
+		XFree(p);
+	}
+	if (pid <= 0)
+		return 0;
+	/* a pid is meaningless unless the client runs on this host */
+	if (!XGetWMClientMachine(dpy, c->win, &tp))
+		return 0;
+	if (gethostname(host, sizeof host) == -1)
+		pid = 0;
+	host[sizeof host - 1] = '\0';
+	if (!tp.value || strcmp((char *)tp.value, host))
+		pid = 0;
+	if (tp.value)
+		XFree(tp.value);
+	return pid;
+}
+
 void
 configure(Client *c) {
 	XConfigureEvent ce;
@@ -353,8 +944,61 @@ configure(Client *c) {
 	XSendEvent(dpy, c->win, False, StructureNotifyMask, (XEvent *)&ce);
 }
 
+void
+configureclient(Client *c, XConfigureRequestEvent *ev) {
+	if (ev->value_mask & CWBorderWidth) {
+		uncarve(c);
+		c->bw = ev->border_width;
+		if (ISVISIBLE(c))
+			carve(c);
+	} else if (c->isfloating
+	|| !themon->lt[ffs(themon->tagset[themon->seltag])]->arrange) {
+		uncarve(c);
+		if (ev->value_mask & CWX) {
+			c->oldx = c->x;
+			c->x = ev->x;
+		}
+		if (ev->value_mask & CWY) {
+			c->oldy = c->y;
+			c->y = ev->y;
+		}
+		if (ev->value_mask & CWWidth) {
+			c->oldw = c->w;
+			c->w = ev->width;
+		}
+		if (ev->value_mask & CWHeight) {
+			c->oldh = c->h;
+			c->h = ev->height;
+		}
+		if ((c->x + c->w) > themon->mw)
+			/* center in x direction */
+			c->x = (themon->mw / 2 - WIDTH(c) / 2);
+		if ((c->y + c->h) > themon->mh)
+			/* center in y direction */
+			c->y = (themon->mh / 2 - HEIGHT(c) / 2);
+		if ((ev->value_mask & (CWX|CWY)) &&
+		    !(ev->value_mask & (CWWidth|CWHeight)))
+			configure(c);
+		if (ISVISIBLE(c)) {
+			carve(c);
+			XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+		}
+	} else
+		configure(c); /* tiled clients keep their geometry */
+}
+
 void
 configurenotify(XEvent *e) {
+	XConfigureEvent *ev = &e->xconfigure;
+
+	if (ev->window == root && (ev->width != sw || ev->height != sh)) {
+		sw = ev->width;
+		sh = ev->height;
+		themon->mw = sw - xreserve;
+		themon->mh = sh - yreserve;
+		themon->spacevalid = 0;
+		setbackground();
+	}
 	focus(NULL);
 	arrange(0);
 }
@@ -362,43 +1006,10 @@ configurenotify(XEvent *e) {
 void
 configurerequest(XEvent *e) {
 	Client *c;
-	XConfigureRequestEvent *ev = &e->xconfigurerequest;
+	XConfigureRequestEvent *ev = &e->xconfigurerequest, *m;
 	XWindowChanges wc;
 
-	if ((c = wintoclient(ev->window))) {
-		if (ev->value_mask & CWBorderWidth)
-			c->bw = ev->border_width;
-		else {
-			if (ev->value_mask & CWX) {
-				c->oldx = c->x;
-				c->x = ev->x;
-			}
-			if (ev->value_mask & CWY) {
-				c->oldy = c->y;
-				c->y = ev->y;
-			}
-			if (ev->value_mask & CWWidth) {
-				c->oldw = c->w;
-				c->w = ev->width;
-			}
-			if (ev->value_mask & CWHeight) {
-				c->oldh = c->h;
-				c->h = ev->height;
-			}
-			if ((c->x + c->w) > themon->mw)
-				/* center in x direction */
-				c->x = (themon->mw / 2 - WIDTH(c) / 2);
-			if ((c->y + c->h) > themon->mh)
-				/* center in y direction */
-				c->y = (themon->mh / 2 - HEIGHT(c) / 2);
-			if ((ev->value_mask & (CWX|CWY)) &&
-			    !(ev->value_mask & (CWWidth|CWHeight)))
-				configure(c);
-			if (ISVISIBLE(c))
-				XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w,
-						  c->h);
-		}
-	} else {
+	if (!(c = wintoclient(ev->window))) {
 		wc.x = ev->x;
 		wc.y = ev->y;
 		wc.width = ev->width;
@@ -407,22 +1018,94 @@ configurerequest(XEvent *e) {
 		wc.sibling = ev->above;
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
+	} else if (!(c->deferred & DfConfigure) && !overbudget(c, RlConfigure)) {
+		configureclient(c, ev);
+	} else {
+		/* later requests win field by field */
+		m = &c->cfgreq;
+		if (!(c->deferred & DfConfigure))
+			m->value_mask = 0;
+		if (ev->value_mask & CWX)
+			m->x = ev->x;
+		if (ev->value_mask & CWY)
+			m->y = ev->y;
+		if (ev->value_mask & CWWidth)
+			m->width = ev->width;
+		if (ev->value_mask & CWHeight)
+			m->height = ev->height;
+		if (ev->value_mask & CWBorderWidth)
+			m->border_width = ev->border_width;
+		m->value_mask |= ev->value_mask;
+		c->deferred |= DfConfigure;
+		settimer(TmRate, ratedelay);
 	}
-	XSync(dpy, False);
 }
 
 Monitor *
 createmon(void) {
 	Monitor *m;
+	unsigned int i;
 
 	m = ecalloc(1, sizeof(Monitor));
 	m->mw = sw - xreserve;
 	m->mh = sh - yreserve;
-	m->tagset[0] = inittag;
-	m->tagset[1] = altinittag;
+	m->tagset[0] = inittags & TAGMASK;
+	m->tagset[1] = altinittags & TAGMASK;
+	m->tagmru = ecalloc(numtags, sizeof(Client *));
+	m->lt = ecalloc(numtags + 1, sizeof(Layout *));
+	for (i = 0; i <= numtags; i++)
+		m->lt[i] = &layouts[0];
 	return m;
 }
 
+/* Cuts r out of the n empty rectangles in s. Every one it overlaps is
+ * replaced by its up to four parts left, right, above and below r, those
+ * contained in another empty rectangle or not overlapping clip are
+ * dropped. s has room for 5n, returns how many are left */
+unsigned int
+cut(Rect *s, unsigned int n, Rect r, const Rect *clip) {
+	Rect f, *p = themon->spacebuf, *q;
+	unsigned int i, j, k = 0, np = 0;
+
+	for (i = 0; i < n; i++) {
+		f = s[i];
+		if (!OVERLAP(r, f)) {
+			s[k++] = f;
+			continue;
+		}
+		if (r.x > f.x)
+			p[np++] = (Rect){ f.x, f.y, r.x - f.x, f.h };
+		if (r.x + r.w < f.x + f.w)
+			p[np++] = (Rect){ r.x + r.w, f.y, f.x + f.w - r.x - r.w, f.h };
+		if (r.y > f.y)
+			p[np++] = (Rect){ f.x, f.y, f.w, r.y - f.y };
+		if (r.y + r.h < f.y + f.h)
+			p[np++] = (Rect){ f.x, r.y + r.h, f.w, f.y + f.h - r.y - r.h };
+	}
+	if (clip) {
+		for (i = j = 0; i < np; i++)
+			if (OVERLAP(p[i], *clip))
+				p[j++] = p[i];
+		np = j;
+	}
+	n = k;
+	for (i = 0; i < np; i++) {
+		/* of two equal parts the first is kept */
+		for (j = 0; j < k + np; j++) {
+			q = j < k ? &s[j] : &p[j - k];
+			if (q != &p[i] && q->x <= p[i].x && q->y <= p[i].y
+			&& q->x + q->w >= p[i].x + p[i].w
+			&& q->y + q->h >= p[i].y + p[i].h
+			&& (j < k + i || q->x != p[i].x || q->y != p[i].y
+			    || q->w != p[i].w || q->h != p[i].h))
+				break;
+		}
+		if (j == k + np)
+			s[n++] = p[i];
+	}
+	return n;
+}
+
 void
 destroynotify(XEvent *e) {
 	Client *c;
@@ -432,30 +1115,217 @@ destroynotify(XEvent *e) {
 		unmanage(c, 1);
 }
 
+void
+detach(Client *c) {
+	Client **tc;
+
+	for (tc = &themon->clients; *tc && *tc != c; tc = &(*tc)->next);
+	*tc = c->next;
+}
+
 void
 detachstack(Client *c) {
-	Client **tc, *t;
+	Client **tc;
 
 	for (tc = &themon->stack; *tc && *tc != c; tc = &(*tc)->snext);
 	*tc = c->snext;
 
-	if (c == themon->sel) {
-		for (t = themon->stack; t && !ISVISIBLE(t); t = t->snext);
-		themon->sel = t;
+	if (c == themon->sel)
+		themon->sel = viewmru();
+}
+
+void
+detachtag(Client *c) {
+	Client **head;
+	unsigned int t, i;
+
+	for (t = c->tags; t; t &= t - 1) {
+		i = ffs(t) - 1;
+		head = &themon->tagmru[i];
+		if (c->tnext[i] == c)
+			*head = NULL;
+		else {
+			c->tprev[i]->tnext[i] = c->tnext[i];
+			c->tnext[i]->tprev[i] = c->tprev[i];
+			if (*head == c)
+				*head = c->tnext[i];
+		}
+		c->tnext[i] = c->tprev[i] = NULL;
+	}
+}
+
+/* inverts the border area c would have at the given geometry, drawing the
+ * same outline twice erases it again */
+void
+drawoutline(Client *c, int x, int y, int w, int h) {
+	XDrawRectangle(dpy, root, seat->outlinegc, x + c->bw / 2, y + c->bw / 2,
+		       w + c->bw, h + c->bw);
+}
+
+/* print the managed clients to stderr, requested with SIGUSR1 */
+/* forgets the display in use after its connection broke, quits once no
+ * display is left */
+void
+dropseat(void) {
+	unsigned int i;
+
+	cleanupseat(); /* Xlib ignores the requests, the rest is freed */
+	XCloseDisplay(dpy);
+	seat->dpy = dpy = NULL;
+	for (i = 0; i < nseats && !seats[i].dpy; i++);
+	if (i == nseats)
+		running = 0;
+}
+
+void
+dumpstate(void) {
+	Client *c;
+
+	fprintf(stderr, "speck: tags 0x%x, %s, spawn %ldus (max %ldus), "
+		"place %ldus (max %ldus), %u empty rectangles, "
+		"sample %ldus (max %ldus)\n",
+		themon->tagset[themon->seltag],
+		themon->lt[ffs(themon->tagset[themon->seltag])]->symbol,
+		seat->spawnlast, seat->spawnmax, seat->placelast,
+		seat->placemax, themon->nspace, seat->samplelast,
+		seat->samplemax);
+	for (c = themon->clients; c; c = c->next)
+		fprintf(stderr, "speck: 0x%lx tags 0x%x pid %d cpu %u.%u%% rss %ldk "
+			"pixmaps %ldk windows %u %dx%d+%d+%d%s%s%s%s%s\n",
+			c->win, c->tags, (int)c->pid, c->cpu / 10, c->cpu % 10,
+			c->rss, c->pixmaps, c->windows, c->w, c->h, c->x, c->y,
+			c == themon->sel ? " sel" : "",
+			c->isfloating ? " floating" : "",
+			c->isfullscreen ? " fullscreen" : "",
+			c->occluded ? " occluded" : "",
+			c->quarantined ? " quarantined" : "");
+}
+
+int
+edgecmp(const void *a, const void *b) {
+	return ((const Edge *)a)->v - ((const Edge *)b)->v;
+}
+
+/* top up every pool with hidden instances, counting those still starting.
+ * Instances that mapped nothing with their _NET_WM_PID in launchtimeout ms
+ * are given up */
+void
+fillpools(void) {
+	unsigned int i, j, n;
+	Client *c;
+	Launch *l;
+	long t = now();
+
+	for (j = 0; j < LENGTH(seat->launches); j++) {
+		l = &seat->launches[j];
+		if (!l->pool)
+			continue;
+		if (t - l->at < launchtimeout) {
+			settimer(TmPool, l->at + launchtimeout - t);
+			continue;
+		}
+		fprintf(stderr, "speck: pool instance %d mapped no window with "
+			"_NET_WM_PID\n", (int)l->pid);
+		memset(l, 0, sizeof(Launch));
+	}
+	for (i = 0; i < LENGTH(pools); i++) {
+		for (n = 0, c = themon->clients; c; c = c->next)
+			n += c->pool == i + 1;
+		for (j = 0; j < LENGTH(seat->launches); j++)
+			n += seat->launches[j].pool == i + 1;
+		for (; n < pools[i].n; n++)
+			if (!launch(pools[i].cmd, i + 1))
+				break;
+	}
+}
+
+/* the launch c came from, by _NET_WM_PID or, for spawn(), by the startup
+ * id the program passed on in _NET_STARTUP_ID. spawn() launches are given
+ * up launchtimeout ms after the launch */
+Launch *
+findlaunch(Client *c) {
+	int di, n = 0;
+	unsigned long dl, id = 0;
+	unsigned char *p = NULL;
+	unsigned int i;
+	Atom da;
+	Launch *l;
+	char pfx[32];
+	long t = now();
+
+	for (i = 0; i < LENGTH(seat->launches); i++) {
+		l = &seat->launches[i];
+		if (l->at && !l->pool && t - l->at > launchtimeout)
+			memset(l, 0, sizeof(Launch));
+		if (c->pid && l->pid == c->pid)
+			return l;
+		n += l->at && !l->pool;
+	}
+	if (!n) /* spare the round trip */
+		return NULL;
+	if (XGetWindowProperty(dpy, c->win, netatom[NetStartupId], 0L, 16L,
+		False, AnyPropertyType, &da, &di, &dl, &dl, &p) == Success
+	&& p) {
+		n = snprintf(pfx, sizeof pfx, "speck%d-", (int)getpid());
+		if (!strncmp((char *)p, pfx, n))
+			id = strtoul((char *)p + n, NULL, 10);
+		XFree(p);
+	}
+	for (i = 0; id && i < LENGTH(seat->launches); i++) {
+		l = &seat->launches[i];
+		if (l->at && !l->pool && l->id == id)
+			return l;
+	}
+	return NULL;
+}
+
+/* does what the rate limits held back, merged into one go per client */
+void
+flushdeferred(void) {
+	Client *c;
+	unsigned int d;
+
+	for (c = themon->clients; c; c = c->next) {
+		if (!(d = c->deferred))
+			continue;
+		c->deferred = 0;
+		if (d & DfConfigure)
+			configureclient(c, &c->cfgreq);
+		if (d & DfHints)
+			updatewmhints(c);
+		if (d & DfType)
+			updatewindowtype(c);
+		if (d & DfTransient)
+			updatetransient(c);
 	}
+	if (seat->focusdeferred && themon->sel)
+		setfocus(themon->sel);
+	seat->focusdeferred = 0;
 }
 
 void
 focus(Client *c) {
 	if (!c || !ISVISIBLE(c))
-		for (c = themon->stack; c && !ISVISIBLE(c); c = c->snext);
+		c = viewmru();
+	if (c && c->occluded) { /* focus left the fullscreen client */
+		unocclude();
+		arrange(0);
+	}
 	if (themon->sel && themon->sel != c)
 		unfocus(themon->sel, 0);
 	if (c) {
 		detachstack(c);
 		attachstack(c);
+		if (c->mruseq != mruseq) { /* not yet at the head of its rings */
+			detachtag(c);
+			attachtag(c);
+		}
+		if (c->parent && c->parent->kids != c)
+			setparent(c, c->parent); /* to the top of its siblings */
 		grabbuttons(c, 1);
-		XSetWindowBorder(dpy, c->win, focusbordercolor.pixel);
+		if (!c->isfullscreen)
+			XSetWindowBorder(dpy, c->win,
+					 seat->focusbordercolor.pixel);
 		setfocus(c);
 	} else {
 		XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
@@ -464,13 +1334,64 @@ focus(Client *c) {
 	themon->sel = c;
 }
 
+/* stop the processes of clients that have been hidden for freezedelay ms,
+ * unless the process still has windows in view or without the rule */
+void
+freezeclients(void) {
+	Client *c, *t;
+	long tm = now();
+
+	for (c = themon->clients; c; c = c->next) {
+		if (!c->freeze || !c->hiddenat || c->isfrozen || !c->pid)
+			continue;
+		if (tm - c->hiddenat < freezedelay) {
+			settimer(TmFreeze, c->hiddenat + freezedelay - tm);
+			continue;
+		}
+		for (t = themon->clients; t; t = t->next)
+			if (t->pid == c->pid && (ISVISIBLE(t) || !t->freeze))
+				break;
+		if (t || kill(c->pid, SIGSTOP) == -1)
+			continue;
+		for (t = themon->clients; t; t = t->next)
+			if (t->pid == c->pid)
+				t->isfrozen = 1;
+	}
+}
+
 /* there are some broken focus acquiring clients needing extra handling */
 void
 focusin(XEvent *e) {
 	XFocusChangeEvent *ev = &e->xfocus;
+	Client *c;
 
-	if (themon->sel && ev->window != themon->sel->win)
-		setfocus(themon->sel);
+	if (!themon->sel || ev->window == themon->sel->win
+	|| seat->focusdeferred)
+		return;
+	/* a client grabbing focus back over and over is sat out */
+	if ((c = wintoclient(ev->window)) && overbudget(c, RlFocus)) {
+		seat->focusdeferred = 1;
+		settimer(TmRate, ratedelay);
+		return;
+	}
+	setfocus(themon->sel);
+}
+
+/* alt-tab style cycling through the clients of the view in MRU order, the
+ * order is only updated once the modifiers are released */
+void
+focusmru(const Arg *arg) {
+	Client *head;
+
+	if (seat->grab.func || !(head = viewmru()) || mrustep(head, 1) == head)
+		return;
+	if (XGrabKeyboard(dpy, root, True, GrabModeAsync, GrabModeAsync,
+		CurrentTime) != GrabSuccess)
+		return;
+	seat->grab.func = mrugrab;
+	seat->grab.c = head;
+	seat->grab.dir = arg->i;
+	previewmru();
 }
 
 void
@@ -498,6 +1419,16 @@ focusstack(const Arg *arg) {
 	}
 }
 
+void
+freeclient(Client *c) {
+	if (arena && c >= arena && c < arena + maxclients) {
+		c->next = freeclients;
+		freeclients = c;
+	} else {
+		free(c);
+	}
+}
+
 Atom
 getatomprop(Client *c, Atom prop) {
 	int di;
@@ -513,6 +1444,43 @@ getatomprop(Client *c, Atom prop) {
 	return atom;
 }
 
+long
+getcardprop(Client *c, Atom prop) {
+	int di;
+	unsigned long dl;
+	unsigned char *p = NULL;
+	Atom da;
+	long v = 0;
+
+	if (XGetWindowProperty(dpy, c->win, prop, 0L, 1L, False, XA_CARDINAL,
+		&da, &di, &dl, &dl, &p) == Success && p) {
+		v = *(long *)p;
+		XFree(p);
+	}
+	return v;
+}
+
+/* finds the entry for key among GEOMPROBE slots, with create the oldest
+ * of them makes room if it is not there */
+Geom *
+getgeom(uint64_t key, int create) {
+	Geom *g, *old = NULL;
+	unsigned int i;
+
+	for (i = 0; i < GEOMPROBE && i < geomhdr->n; i++) {
+		g = &geoms[(key + i) % geomhdr->n];
+		if (g->key == key)
+			return g;
+		if (!old || g->used < old->used)
+			old = g;
+	}
+	if (!create)
+		return NULL;
+	memset(old, 0, sizeof(Geom));
+	old->key = key;
+	return old;
+}
+
 int
 getrootptr(int *x, int *y) {
 	int di;
@@ -581,41 +1549,273 @@ grabkeys(void) {
 }
 
 void
-keypress(XEvent *e) {
-	unsigned int i;
-	KeySym keysym;
-	XKeyEvent *ev;
+grid(Monitor *m) {
+	unsigned int i, n, cols, rows, cn, rn;
+	int cw, ch;
+	Client *c;
 
-	ev = &e->xkey;
-	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < LENGTH(keys); i++)
-		if (keysym == keys[i].keysym
-		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func)
-			keys[i].func(&(keys[i].arg));
+	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
+	if (n == 0)
+		return;
+	for (cols = 1; cols * cols < n; cols++);
+	rows = n / cols;
+	cw = m->mw / cols;
+	for (i = cn = rn = 0, c = nexttiled(m->clients); c;
+	     c = nexttiled(c->next), i++) {
+		/* the rightmost n % cols columns take one extra row */
+		if (i / rows + 1 > cols - n % cols)
+			rows = n / cols + 1;
+		ch = m->mh / rows;
+		resize(c, cn * cw, rn * ch, cw - 2 * c->bw, ch - 2 * c->bw);
+		if (++rn >= rows) {
+			rn = 0;
+			cn++;
+		}
+	}
 }
 
+/* makes room for n empty rectangles, kept between calls */
 void
-killclient(const Arg *arg) {
-	if (!themon->sel)
+growspace(unsigned int n) {
+	unsigned int cap = themon->spacecap;
+	Rect *r, *u;
+
+	if (n <= cap)
 		return;
-	if (!sendevent(themon->sel, wmatom[WMDelete])) {
-		XGrabServer(dpy);
-		XSetErrorHandler(xerrordummy);
-		XKillClient(dpy, themon->sel->win);
-		XSync(dpy, False);
-		XSetErrorHandler(xerror);
-		XUngrabServer(dpy);
+	themon->spacecap = MAX(n, 2 * cap);
+	r = ecalloc(themon->spacecap, sizeof(Rect));
+	u = ecalloc(themon->spacecap, sizeof(Rect));
+	if (cap) {
+		memcpy(r, themon->space, cap * sizeof(Rect));
+		memcpy(u, themon->spacenew, cap * sizeof(Rect));
+	}
+	free(themon->space);
+	free(themon->spacebuf);
+	free(themon->spacenew);
+	themon->space = r;
+	themon->spacenew = u;
+	themon->spacebuf = ecalloc(themon->spacecap, sizeof(Rect));
+}
+
+void
+handlesignals(void) {
+	struct signalfd_siginfo si;
+	unsigned int i;
+	pid_t pid;
+
+	while (read(sigfd, &si, sizeof si) == sizeof si)
+		switch (si.ssi_signo) {
+		case SIGCHLD:
+			while (0 < (pid = waitpid(-1, NULL, WNOHANG)))
+				for (i = 0; i < nseats; i++) {
+					if (!seats[i].dpy)
+						continue;
+					useseat(&seats[i]);
+					if (takelaunch(pid)) { /* died before mapping */
+						settimer(TmPool, pooldelay);
+						break;
+					}
+				}
+			break;
+		case SIGTERM:
+			running = 0;
+			break;
+		case SIGUSR1:
+			for (i = 0; i < nseats; i++) {
+				if (!seats[i].dpy)
+					continue;
+				useseat(&seats[i]);
+				if (nseats > 1)
+					fprintf(stderr, "speck: display %s\n",
+						seat->name);
+				dumpstate();
+			}
+			break;
+		}
+}
+
+/* those already off screen stay */
+void
+hideclient(Client *c) {
+	if (c->hiddenat)
+		return;
+	XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+	c->hiddenat = now();
+	if (c->freeze)
+		settimer(TmFreeze, freezedelay);
+}
+
+void
+keypress(XEvent *e) {
+	unsigned int i;
+	KeySym keysym;
+	XKeyEvent *ev;
+
+	ev = &e->xkey;
+	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
+	for (i = 0; i < LENGTH(keys); i++)
+		if (keysym == keys[i].keysym
+		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
+		&& keys[i].func)
+			keys[i].func(&(keys[i].arg));
+}
+
+void
+killclient(const Arg *arg) {
+	if (themon->sel)
+		killgroup(themon->sel, 0);
+}
+
+/* closes c and then its transients, killing what does not answer. A kid
+ * without WM_DELETE_WINDOW is left to go with c, killing its connection
+ * would take c along before c saw its own WM_DELETE_WINDOW */
+void
+killgroup(Client *c, int kid) {
+	Client *t;
+
+	if (c->pingsent && now() - c->pingsent >= pingtimeout) {
+		killhung(c);
+		return;
+	}
+	if (sendevent(c, wmatom[WMDelete])) {
+		if (!c->pingsent && sendevent(c, netatom[NetWMPing])) {
+			c->pingsent = now();
+			settimer(TmPing, pingtimeout);
+		}
+	} else if (!kid) {
+		killwin(c);
+		return;
+	}
+	for (t = c->kids; t; t = t->sib)
+		killgroup(t, 1);
+}
+
+/* the client stopped answering pings, its process goes if it is known */
+void
+killhung(Client *c) {
+	c->pingsent = 0;
+	if (c->pid > 0 && kill(c->pid, SIGKILL) == 0)
+		return;
+	killwin(c);
+}
+
+/* closes the X connection of c, for clients without WM_DELETE_WINDOW */
+void
+killwin(Client *c) {
+	XSetErrorHandler(xerrordummy);
+	XKillClient(dpy, c->win);
+	XSync(dpy, False);
+	XSetErrorHandler(xerror);
+}
+
+/* posix_spawnp() shares our address space until the exec instead of
+ * copying it like fork(), so launching does not stall event handling.
+ * The launch is remembered with the view and a startup id, in a free slot
+ * or else that of the oldest spawn() */
+pid_t
+launch(const char **argv, unsigned int pool) {
+	int err;
+	pid_t pid;
+	sigset_t sm;
+	posix_spawnattr_t attr;
+	struct timespec t0, t1;
+	char id[32];
+	unsigned int i;
+	Launch *l = NULL, *o;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	posix_spawnattr_init(&attr);
+	/* the blocked signal mask would survive the exec */
+	sigemptyset(&sm);
+	posix_spawnattr_setsigmask(&attr, &sm);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK|POSIX_SPAWN_SETSID);
+	/* in a farm the child belongs on the display it is launched for */
+	if (seat->name)
+		setenv("DISPLAY", seat->name, 1);
+	snprintf(id, sizeof id, "speck%d-%lu", (int)getpid(), ++launchseq);
+	setenv("DESKTOP_STARTUP_ID", id, 1);
+	if ((err = posix_spawnp(&pid, argv[0], NULL, &attr, (char **)argv,
+	    environ))) {
+		fprintf(stderr, "speck: posix_spawnp %s failed: %s\n", argv[0],
+			strerror(err));
+		pid = 0;
+	}
+	unsetenv("DESKTOP_STARTUP_ID");
+	posix_spawnattr_destroy(&attr);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	seat->spawnlast = (t1.tv_sec - t0.tv_sec) * 1000000
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000;
+	seat->spawnmax = MAX(seat->spawnmax, seat->spawnlast);
+	for (i = 0; pid && i < LENGTH(seat->launches); i++) {
+		o = &seat->launches[i];
+		if (!o->at) {
+			l = o;
+			break;
+		}
+		if (!o->pool && (!l || o->at < l->at))
+			l = o;
+	}
+	if (l) {
+		l->pid = pid;
+		l->pool = pool;
+		l->tags = themon->tagset[themon->seltag];
+		l->id = launchseq;
+		l->at = now();
+	}
+	return pid;
+}
+
+/* looks c up in the geometry memory by class, instance and WM_WINDOW_ROLE,
+ * a remembered tag only applies if no rule set one */
+void
+loadgeom(Client *c, const char *class, const char *instance) {
+	int di;
+	unsigned long dl;
+	unsigned char *p = NULL;
+	Atom da;
+	const char *role = "";
+	uint64_t h = 14695981039346656037ULL; /* FNV-1a */
+	const char *s[3];
+	unsigned int i;
+	Geom *g;
+
+	if (!geomhdr)
+		return;
+	if (XGetWindowProperty(dpy, c->win, wmatom[WMWindowRole], 0L, 64L,
+	    False, XA_STRING, &da, &di, &dl, &dl, &p) == Success && p)
+		role = (char *)p;
+	s[0] = class;
+	s[1] = instance;
+	s[2] = role;
+	for (i = 0; i < LENGTH(s); i++)
+		do
+			h = (h ^ (unsigned char)*s[i]) * 1099511628211ULL;
+		while (*s[i]++);
+	if (p)
+		XFree(p);
+	c->geomkey = h ? h : 1;
+	if (!(g = getgeom(c->geomkey, 0)))
+		return;
+	if (!c->tags && g->tags & TAGMASK)
+		c->tags = g->tags & TAGMASK;
+	if (g->w > 0 && g->h > 0) {
+		c->hasxy = 1;
+		c->x = c->oldx = g->x;
+		c->y = c->oldy = g->y;
+		c->w = c->oldw = g->w;
+		c->h = c->oldh = g->h;
 	}
 }
 
 void
 manage(Window w, XWindowAttributes *wa) {
 	Client *c, *t = NULL;
+	Launch *l = NULL;
 	Window trans = None;
 	XWindowChanges wc;
+	int i;
 
-	c = ecalloc(1, sizeof(Client));
+	c = allocclient();
 	c->win = w;
 	/* geometry */
 	c->x = c->oldx = wa->x;
@@ -623,13 +1823,38 @@ manage(Window w, XWindowAttributes *wa) {
 	c->w = c->oldw = wa->width;
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
+	for (i = 0; i < RlLast; i++) {
+		c->tokens[i] = rates[i];
+		c->spent[i] = now();
+	}
 
+	c->pid = clientpid(c);
+	if (sampleinterval)
+		settimer(TmSample, sampleinterval);
 	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
-		c->tag = t->tag;
+		setparent(c, t);
+		c->tags = t->tags;
+		c->freeze = t->freeze;
+		c->isfloating = 1;
+	} else if ((l = findlaunch(c)) && l->pool) {
+		c->pool = l->pool;
+		memset(l, 0, sizeof(Launch));
+		applyrules(c); /* freeze and the geometry memory */
+		c->tags = 0; /* hidden until spawn() hands it out */
 	} else {
 		applyrules(c);
+		if (l) /* where it was spawned, whatever rules or memory say */
+			c->tags = l->tags;
 	}
+	cgplace(c->pid, c->tags);
 
+	c->bw = borderpx;
+	if (!t && !c->pool && !c->hasxy && ISVISIBLE(c)
+	&& !themon->lt[ffs(themon->tagset[themon->seltag])]->arrange) {
+		updatesizehints(c);
+		if (!c->hasxy)
+			place(c);
+	}
 	if (c->x + WIDTH(c) > themon->mw)
 		c->x = themon->mw - WIDTH(c);
 	if (c->y + HEIGHT(c) > themon->mh)
@@ -637,21 +1862,23 @@ manage(Window w, XWindowAttributes *wa) {
 	c->x = MAX(c->x, 0);
 	c->y = MAX(c->y, 0);
 
-	c->bw = borderpx;
 	wc.border_width = c->bw;
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
-	XSetWindowBorder(dpy, w, unfocusbordercolor.pixel);
+	XSetWindowBorder(dpy, w, seat->unfocusbordercolor.pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
 	updatewindowtype(c);
 	updatewmhints(c);
 	XSelectInput(dpy, w, FocusChangeMask|PropertyChangeMask);
 	grabbuttons(c, 0);
 
-	XRaiseWindow(dpy, c->win);
-
+	attach(c);
 	attachstack(c);
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
-	    PropModeAppend, (unsigned char *) &(c->win), 1);
+	attachtag(c);
+	if (ISVISIBLE(c))
+		carve(c);
+	if (!c->pool) /* listed once spawn() hands it out */
+		XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW,
+		    32, PropModeAppend, (unsigned char *) &(c->win), 1);
 	/* some windows require this */
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h);
 	setclientstate(c, NormalState);
@@ -702,75 +1929,358 @@ minimize(const Arg *arg) {
 	resize(c, c->oldx, c->oldy, c->oldw, c->oldh);
 }
 
+/* a step of movemouse(), until the button is released */
+int
+movegrab(XEvent *e) {
+	Grab *g = &seat->grab;
+	Client *c = g->c;
+	int nx, ny;
+
+	if (e && e->type == MotionNotify) {
+		if ((e->xmotion.time - g->lasttime) <= (1000 / 60))
+			return 1;
+		g->lasttime = e->xmotion.time;
+		if (outline)
+			drawoutline(c, g->x, g->y, c->w, c->h);
+		nx = g->ox + (e->xmotion.x - g->px);
+		ny = g->oy + (e->xmotion.y - g->py);
+		g->x = snapaxis(seat->snapx, seat->nsnap, nx, WIDTH(c),
+				ny, ny + HEIGHT(c));
+		g->y = snapaxis(seat->snapy, seat->nsnap, ny, HEIGHT(c),
+				nx, nx + WIDTH(c));
+		if (outline)
+			drawoutline(c, g->x, g->y, c->w, c->h);
+		else
+			resize(c, g->x, g->y, c->w, c->h);
+		return 1;
+	}
+	if (e && e->type != ButtonRelease)
+		return e->type == ButtonPress;
+	g->func = NULL;
+	if (outline) {
+		drawoutline(c, g->x, g->y, c->w, c->h);
+		resize(c, g->x, g->y, c->w, c->h);
+	}
+	XUngrabPointer(dpy, CurrentTime);
+	arrange(0);
+	return 1;
+}
+
 void
 movemouse(const Arg *arg) {
-	int x, y, ocx, ocy, nx, ny;
+	Grab *g = &seat->grab;
 	Client *c;
-	XEvent ev;
-	Time lasttime = 0;
 
-	if (!(c = themon->sel))
+	if (g->func || !(c = themon->sel))
 		return;
 	if (c->isfullscreen) /* no support moving fullscreen windows by mouse */
 		return;
+	c->isfloating = 1;
 	restack(themon);
-	ocx = c->x;
-	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
 		None, None, CurrentTime) != GrabSuccess)
 		return;
-	if (!getrootptr(&x, &y))
+	if (!getrootptr(&g->px, &g->py))
 		return;
-	do {
-		XMaskEvent(dpy, MOUSEMASK|SubstructureRedirectMask,
-			   &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case MapRequest:
-			handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nx = ocx + (ev.xmotion.x - x);
-			ny = ocy + (ev.xmotion.y - y);
-			if (abs(nx) < snap)
-				nx = 0;
-			else if (abs(themon->mw - (nx + WIDTH(c))) < snap)
-				nx = themon->mw - WIDTH(c);
-			if (abs(ny) < snap)
-				ny = 0;
-			else if (abs(themon->mh - (ny + HEIGHT(c))) < snap)
-				ny = themon->mh - HEIGHT(c);
-			
-			resize(c, nx, ny, c->w, c->h);
-			break;
+	buildsnap(c);
+	g->func = movegrab;
+	g->c = c;
+	g->x = g->ox = c->x;
+	g->y = g->oy = c->y;
+	g->lasttime = 0;
+	if (outline)
+		drawoutline(c, g->x, g->y, c->w, c->h);
+}
+
+/* Offset from v to the closest edge in e, sorted by position, that is
+ * less than snap pixels off and whose extent comes within snap of
+ * [lo, hi). An edge of a window far off on the other axis is no reason to
+ * snap, one of an adjacent window is. snap if there is none */
+int
+nearestedge(const Edge *e, unsigned int n, int v, int lo, int hi) {
+	unsigned int i = 0, j = n, mid;
+	int d, s = snap, best = s;
+
+	while (i < j) {
+		mid = (i + j) / 2;
+		if (e[mid].v <= v - s)
+			i = mid + 1;
+		else
+			j = mid;
+	}
+	for (; i < n && e[i].v < v + s; i++) {
+		d = e[i].v - v;
+		if (abs(d) < abs(best) && e[i].lo < hi + s && e[i].hi > lo - s)
+			best = d;
+	}
+	return best;
+}
+
+Client *
+nexttiled(Client *c) {
+	for (; c; c = c->next) {
+		if (!c->hintsvalid)
+			updatesizehints(c);
+		if (ISVISIBLE(c) && !c->isfloating && !c->isfullscreen
+		&& !c->isfixed)
+			return c;
+	}
+	return NULL;
+}
+
+/* a key of focusmru(): steps on further non-modifier presses and focuses
+ * the client stepped to on a modifier release */
+int
+mrugrab(XEvent *e) {
+	int ismod;
+
+	if (e && e->type != KeyPress && e->type != KeyRelease)
+		return 0;
+	if (e) {
+		ismod = IsModifierKey(XKeycodeToKeysym(dpy,
+			(KeyCode)e->xkey.keycode, 0));
+		if (e->type == KeyPress && !ismod)
+			previewmru();
+		if (e->type == KeyPress || !ismod)
+			return 1;
+	}
+	seat->grab.func = NULL;
+	XUngrabKeyboard(dpy, CurrentTime);
+	themon->nstacking = 0; /* the previews raised windows on their own */
+	focus(seat->grab.c);
+	restack(themon);
+	return 1;
+}
+
+/* the client after c in MRU order on the view, before it for dir < 0 */
+Client *
+mrustep(Client *c, int dir) {
+	unsigned int t = themon->tagset[themon->seltag];
+	Client *i, *n = NULL;
+
+	if (!(t & (t - 1))) /* one tag, its ring has the order */
+		return dir > 0 ? c->tnext[ffs(t) - 1] : c->tprev[ffs(t) - 1];
+	/* with several the focus stack has it, in one list */
+	if (dir > 0) {
+		for (n = c->snext; n && !ISVISIBLE(n); n = n->snext);
+		if (!n)
+			for (n = themon->stack; !ISVISIBLE(n); n = n->snext);
+		return n;
+	}
+	for (i = themon->stack; i != c; i = i->snext)
+		if (ISVISIBLE(i))
+			n = i;
+	if (!n)
+		for (i = c->snext; i; i = i->snext)
+			if (ISVISIBLE(i))
+				n = i;
+	return n ? n : c;
+}
+
+long
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* unmaps what c covers on its tags, apart from its transients and other
+ * windows of its process. Clients also on tags c is not on stay. They get
+ * no layout, borders or stacking until unocclude() maps them again */
+void
+occlude(Client *c) {
+	Client *t, *p;
+
+	if (!c->tags) /* held back in a pool */
+		return;
+	themon->fullscreen = c;
+	for (t = themon->clients; t; t = t->next) {
+		for (p = t; p && p != c; p = p->parent);
+		if (p || !t->tags || t->tags & ~c->tags || t->occluded
+		|| (c->pid && t->pid == c->pid))
+			continue;
+		t->occluded = 1;
+		t->ignoreunmap++;
+		XUnmapWindow(dpy, t->win);
+		setclientstate(t, IconicState);
+	}
+}
+
+/* maps $HOME/geomfile, starting it over if it does not hold geomslots
+ * entries of this version */
+void
+opengeom(void) {
+	char path[512];
+	const char *home;
+	struct stat st;
+	size_t size = sizeof(GeomHdr) + geomslots * sizeof(Geom);
+	void *p;
+	int fd;
+
+	if (!geomfile[0] || !geomslots || !(home = getenv("HOME")))
+		return;
+	snprintf(path, sizeof path, "%s/%s", home, geomfile);
+	if ((fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0600)) == -1) {
+		fprintf(stderr, "speck: open %s: %s\n", path, strerror(errno));
+		return;
+	}
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size != size)
+		if (ftruncate(fd, 0) == -1 || ftruncate(fd, size) == -1) {
+			fprintf(stderr, "speck: ftruncate %s: %s\n", path,
+				strerror(errno));
+			close(fd);
+			return;
 		}
-	} while (ev.type != ButtonRelease);
-	XUngrabPointer(dpy, CurrentTime);
+	p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "speck: mmap %s: %s\n", path, strerror(errno));
+		return;
+	}
+	geomhdr = p;
+	geoms = (Geom *)(geomhdr + 1);
+	if (geomhdr->magic != GEOMMAGIC || geomhdr->n != geomslots) {
+		memset(p, 0, size);
+		geomhdr->magic = GEOMMAGIC;
+		geomhdr->n = geomslots;
+	}
+}
+
+/* Takes a token from the bucket of c for an event of class r, the buckets
+ * refilling at rates[r] per second. Returns 1 if the event has to wait. A
+ * client keeps paying while it waits, so it is quarantined once it has
+ * been over budget quarantine times and released when it has been quiet
+ * long enough to fill its buckets again */
+int
+overbudget(Client *c, int r) {
+	static const char *name[RlLast] = { "configure", "property", "focus" };
+	long t = now();
+
+	c->tokens[r] = MIN(rates[r],
+	    c->tokens[r] + (t - c->spent[r]) * rates[r] / 1000);
+	c->spent[r] = t;
+	if (c->tokens[r] >= rates[r]) {
+		if (c->quarantined)
+			fprintf(stderr, "speck: 0x%lx (pid %d) calmed down\n",
+				c->win, (int)c->pid);
+		c->strikes = c->quarantined = 0;
+	}
+	c->tokens[r] = MAX(c->tokens[r] - 1, -rates[r]);
+	if (c->tokens[r] >= 0 && !c->quarantined)
+		return 0;
+	if (++c->strikes == quarantine) {
+		c->quarantined = 1;
+		fprintf(stderr, "speck: 0x%lx (pid %d) floods %s events, "
+			"quarantined\n", c->win, (int)c->pid, name[r]);
+	}
+	return 1;
+}
+
+/* puts floating c into the smallest empty rectangle of the view it fits,
+ * cascading from the top left if there is none */
+void
+place(Client *c) {
+	struct timespec t0, t1;
+	Rect *f, *best = NULL;
+	int w = WIDTH(c), h = HEIGHT(c);
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (!themon->spacevalid)
+		buildspace();
+	for (i = 0; i < themon->nspace; i++) {
+		f = &themon->space[i];
+		if (f->w < w || f->h < h)
+			continue;
+		if (!best || (long)f->w * f->h < (long)best->w * best->h
+		|| ((long)f->w * f->h == (long)best->w * best->h
+		    && (f->y < best->y || (f->y == best->y && f->x < best->x))))
+			best = f;
+	}
+	if (best) {
+		c->x = best->x;
+		c->y = best->y;
+	} else {
+		if (themon->cascadeat + w > themon->mw
+		|| themon->cascadeat + h > themon->mh)
+			themon->cascadeat = 0;
+		c->x = c->y = themon->cascadeat;
+		themon->cascadeat += cascade;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	seat->placelast = (t1.tv_sec - t0.tv_sec) * 1000000
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000;
+	seat->placemax = MAX(seat->placemax, seat->placelast);
+}
+
+/* moves the focusmru() highlight one step on and raises the client */
+void
+previewmru(void) {
+	Grab *g = &seat->grab;
+
+	XSetWindowBorder(dpy, g->c->win, seat->unfocusbordercolor.pixel);
+	g->c = mrustep(g->c, g->dir);
+	XSetWindowBorder(dpy, g->c->win, seat->focusbordercolor.pixel);
+	XRaiseWindow(dpy, g->c->win);
+}
+
+/* CPU time in clock ticks and resident pages of pid from /proc */
+int
+procstat(pid_t pid, long *ticks, long *rss) {
+	char buf[1024], *p;
+	unsigned long ut, st;
+	ssize_t n;
+	int fd;
+
+	snprintf(buf, sizeof buf, "/proc/%d/stat", (int)pid);
+	if ((fd = open(buf, O_RDONLY|O_CLOEXEC)) == -1)
+		return -1;
+	n = read(fd, buf, sizeof buf - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	/* the command name may contain anything, fields follow its ')' */
+	if (!(p = strrchr(buf, ')')) || sscanf(p + 2, "%*c %*d %*d %*d %*d "
+	    "%*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u "
+	    "%*u %ld", &ut, &st, rss) != 3)
+		return -1;
+	*ticks = ut + st;
+	return 0;
 }
 
 void
 propertynotify(XEvent *e) {
 	Client *c;
 	XPropertyEvent *ev = &e->xproperty;
+	unsigned int d = 0;
 
 	if (ev->state == PropertyDelete)
 		return; /* ignore */
-	else if ((c = wintoclient(ev->window))) {
-		switch(ev->atom) {
-		default: break;
-		case XA_WM_NORMAL_HINTS:
-			c->hintsvalid = 0;
-			break;
-		case XA_WM_HINTS:
-			updatewmhints(c);
-			break;
-		}
-		if (ev->atom == netatom[NetWMWindowType])
-			updatewindowtype(c);
+	if (!(c = wintoclient(ev->window)))
+		return;
+	if (ev->atom == XA_WM_NORMAL_HINTS) {
+		c->hintsvalid = 0; /* read when next needed */
+		return;
+	}
+	if (ev->atom == XA_WM_HINTS)
+		d = DfHints;
+	else if (ev->atom == XA_WM_TRANSIENT_FOR)
+		d = DfTransient;
+	else if (ev->atom == netatom[NetWMWindowType])
+		d = DfType;
+	if (!d || c->deferred & d) /* merged into the pending update */
+		return;
+	if (overbudget(c, RlProperty)) {
+		c->deferred |= d;
+		settimer(TmRate, ratedelay);
+	} else if (d == DfHints) {
+		updatewmhints(c);
+	} else if (d == DfTransient) {
+		updatetransient(c);
+	} else {
+		updatewindowtype(c);
 	}
 }
 
@@ -789,79 +2299,364 @@ void
 resizeclient(Client *c, int x, int y, int w, int h) {
 	XWindowChanges wc;
 
+	uncarve(c);
 	c->oldx = c->x; c->x = wc.x = x;
 	c->oldy = c->y; c->y = wc.y = y;
 	c->oldw = c->w; c->w = wc.width = w;
 	c->oldh = c->h; c->h = wc.height = h;
 	wc.border_width = c->bw;
+	if (ISVISIBLE(c))
+		carve(c);
+	else if (c->hiddenat) /* keep it off screen */
+		wc.x = WIDTH(c) * -2;
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
-	XSync(dpy, False);
+}
+
+/* a step of resizemouse(), until the button is released */
+int
+resizegrab(XEvent *e) {
+	Grab *g = &seat->grab;
+	Client *c = g->c;
+	int nw, nh;
+
+	if (e && e->type == MotionNotify) {
+		if ((e->xmotion.time - g->lasttime) <= (1000 / 60))
+			return 1;
+		g->lasttime = e->xmotion.time;
+		nw = MAX(e->xmotion.x - g->ox - 2 * c->bw + 1, 1);
+		nh = MAX(e->xmotion.y - g->oy - 2 * c->bw + 1, 1);
+		if (nw < 0 || nw > themon->mw || nh < 0 || nh > themon->mh)
+			return 1;
+		if (!outline) {
+			resize(c, c->x, c->y, nw, nh);
+			return 1;
+		}
+		/* the outline obeys the size hints as well */
+		drawoutline(c, g->x, g->y, g->w, g->h);
+		g->x = c->x;
+		g->y = c->y;
+		applysizehints(c, &g->x, &g->y, &nw, &nh);
+		g->w = nw;
+		g->h = nh;
+		drawoutline(c, g->x, g->y, g->w, g->h);
+		return 1;
+	}
+	if (e && e->type != ButtonRelease)
+		return e->type == ButtonPress;
+	g->func = NULL;
+	if (outline) {
+		drawoutline(c, g->x, g->y, g->w, g->h);
+		resize(c, g->x, g->y, g->w, g->h);
+	}
+	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1,
+		     c->h + c->bw - 1);
+	XUngrabPointer(dpy, CurrentTime);
+	arrange(0);
+	return 1;
 }
 
 void
 resizemouse(const Arg *arg) {
-	int ocx, ocy, nw, nh;
+	Grab *g = &seat->grab;
 	Client *c;
-	XEvent ev;
-	Time lasttime = 0;
 
-	if (!(c = themon->sel))
+	if (g->func || !(c = themon->sel))
 		return;
 	if (c->isfullscreen) /* no support resizing fullscreen windows by mouse */
 		return;
+	c->isfloating = 1;
 	restack(themon);
-	ocx = c->x;
-	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
 		None, None, CurrentTime) != GrabSuccess)
 		return;
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1,
 		     c->h + c->bw - 1);
-	do {
-		XMaskEvent(dpy, MOUSEMASK|SubstructureRedirectMask,
-			   &ev);
-		switch(ev.type) {
-		case ConfigureRequest:
-		case MapRequest:
-			handler[ev.type](&ev);
-			break;
-		case MotionNotify:
-			if ((ev.xmotion.time - lasttime) <= (1000 / 60))
-				continue;
-			lasttime = ev.xmotion.time;
-
-			nw = MAX(ev.xmotion.x - ocx - 2 * c->bw + 1, 1);
-			nh = MAX(ev.xmotion.y - ocy - 2 * c->bw + 1, 1);
-			if (nw >= 0 && nw <= themon->mw && nh >= 0 &&
-			    nh <= themon->mh)
-				resize(c, c->x, c->y, nw, nh);
-			break;
-		}
-	} while (ev.type != ButtonRelease);
-	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1,
-		     c->h + c->bw - 1);
-	XUngrabPointer(dpy, CurrentTime);
+	g->func = resizegrab;
+	g->c = c;
+	g->x = g->ox = c->x;
+	g->y = g->oy = c->y;
+	g->w = c->w;
+	g->h = c->h;
+	g->lasttime = 0;
+	if (outline)
+		drawoutline(c, g->x, g->y, g->w, g->h);
 }
 
+/* Stacks fullscreen clients over the rest, transients over their parents
+ * and everything else by recency. Only the span that differs from what was
+ * last sent is restacked, below the first window above it that stayed, or
+ * just the one window that moved if that is all. */
 void
 restack(Monitor *m) {
-	if (!m->sel)
+	Client *c;
+	Window *w, *o;
+	unsigned int i, n, t, b, e, no = m->nstacking;
+
+	for (n = 0, c = m->stack; c; c = c->snext, n++);
+	if (n > m->stackcap) {
+		m->stackcap = MAX(2 * m->stackcap, n);
+		w = ecalloc(m->stackcap, sizeof(Window));
+		if (no)
+			memcpy(w, m->stacking, no * sizeof(Window));
+		free(m->stacking);
+		free(m->stackbuf);
+		m->stacking = w;
+		m->stackbuf = ecalloc(m->stackcap, sizeof(Window));
+	}
+	/* pool instances stay out of it, as out of _NET_CLIENT_LIST */
+	w = m->stackbuf;
+	for (c = m->stack; c; c = c->snext)
+		if (c->isfullscreen && !c->parent && !c->pool) {
+			w = stackfamily(c->kids, w);
+			*w++ = c->win;
+		}
+	for (c = m->stack; c; c = c->snext)
+		if (!c->isfullscreen && !c->parent && !c->pool) {
+			w = stackfamily(c->kids, w);
+			*w++ = c->win;
+		}
+	n = w - m->stackbuf;
+
+	w = m->stackbuf;
+	o = m->stacking;
+	for (t = 0; t < n && t < no && w[t] == o[t]; t++);
+	for (b = 0; b < n - t && b < no - t && w[n - 1 - b] == o[no - 1 - b];
+	     b++);
+	e = n - b - 1; /* last of the span */
+	if (t < n - b && n == no && w[t] == o[e]
+	&& !memcmp(w + t + 1, o + t, (e - t) * sizeof(Window))) {
+		if (t) /* moved up */
+			XRestackWindows(dpy, w + t - 1, 2);
+		else
+			XRaiseWindow(dpy, w[0]);
+	} else if (t < n - b && n == no && w[e] == o[t]
+	&& !memcmp(w + t, o + t + 1, (e - t) * sizeof(Window))) {
+		XRestackWindows(dpy, w + e - 1, 2); /* moved down */
+	} else if (t < n - b) {
+		if (!t)
+			XRaiseWindow(dpy, w[0]);
+		XRestackWindows(dpy, w + (t ? t - 1 : 0), n - b - t + (t ? 1 : 0));
+	}
+	w = m->stacking;
+	m->stacking = m->stackbuf;
+	m->stackbuf = w;
+	m->nstacking = n;
+	if (n == no && t == n)
 		return;
-	XRaiseWindow(dpy, m->sel->win);
-	XSync(dpy, False);
+
+	/* _NET_CLIENT_LIST_STACKING runs bottom to top */
+	for (i = 0; i < n; i++)
+		m->stackbuf[i] = m->stacking[n - 1 - i];
+	if (no && b == no) /* only new windows on top */
+		XChangeProperty(dpy, root, netatom[NetClientListStacking],
+				XA_WINDOW, 32, PropModeAppend,
+				(unsigned char *)(m->stackbuf + no), n - no);
+	else
+		XChangeProperty(dpy, root, netatom[NetClientListStacking],
+				XA_WINDOW, 32, PropModeReplace,
+				(unsigned char *)m->stackbuf, n);
 }
 
 void
 run(void) {
 	XEvent ev;
+	struct pollfd *fds, *f;
+	unsigned int i, n = 2 * nseats + 1;
+
+	/* the signals, then connection and timers of every display */
+	fds = ecalloc(n, sizeof(struct pollfd));
+	fds[0].fd = sigfd;
+	fds[0].events = POLLIN;
+	for (i = 0; i < nseats; i++) {
+		useseat(&seats[i]);
+		XSync(dpy, False);
+		f = &fds[2 * i + 1];
+		f[0].fd = ConnectionNumber(dpy);
+		f[0].events = f[0].revents = POLLIN; /* drain it first */
+		f[1].fd = seat->timerfd;
+		f[1].events = POLLIN;
+	}
+	while (running) {
+		/* drain everything Xlib has queued or can read without blocking,
+		 * on the displays that woke up; the others are left untouched */
+		for (i = 0; running && i < nseats; i++) {
+			f = &fds[2 * i + 1];
+			if (!seats[i].dpy
+			|| (!f[0].revents && !f[1].revents && !seats[i].lost))
+				continue;
+			useseat(&seats[i]);
+			if (f[1].revents & POLLIN)
+				runtimers();
+			while (running && !seat->lost && XPending(dpy)) {
+				XNextEvent(dpy, &ev);
+				if (seat->grab.func && seat->grab.func(&ev))
+					continue;
+				if (handler[ev.type])
+					handler[ev.type](&ev); /* call handler */
+			}
+			if (seat->lost) {
+				dropseat();
+				f[0].fd = f[1].fd = -1; /* poll() skips them */
+			}
+		}
+		if (!running)
+			break;
+		if (poll(fds, n, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			die("poll:");
+		}
+		if (fds[0].revents & POLLIN)
+			handlesignals();
+	}
+	free(fds);
+}
 
-	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+void
+runtimers(void) {
+	uint64_t expirations;
+	long t;
+	int i;
+
+	if (read(seat->timerfd, &expirations, sizeof expirations) == -1
+	&& errno != EAGAIN)
+		die("read timerfd:");
+	t = now();
+	for (i = 0; i < TmLast; i++)
+		if (seat->timers[i] && seat->timers[i] <= t) {
+			seat->timers[i] = 0;
+			timerfunc[i]();
+		}
+	armtimers();
+}
+
+/* Samples CPU time and RSS, and with XRes the pixmaps and windows, of up
+ * to samplebatch clients per call, taking turns. All clients are published
+ * as _SPECK_USAGE on the root window when a value changed: window, pid,
+ * permille of a CPU, RSS in kB, pixmaps in kB and windows for each. The
+ * timer stops while there are no clients, manage() starts it again */
+void
+sampleclients(void) {
+	struct timespec t0, t1;
+	Client *c;
+	unsigned int i, j, n, changed = 0;
+	long ticks, rss, v[6], t = now();
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (c = themon->clients, n = 0; c; c = c->next, n++) {
+		if (n < seat->sampleat || n >= seat->sampleat + samplebatch)
+			continue;
+#ifdef XRES
+		if (seat->hasxres)
+			xresstat(c);
+#endif /* XRES */
+		if (!c->pid)
+			continue;
+		if (procstat(c->pid, &ticks, &rss) == -1) {
+			c->cpu = c->rss = 0;
+			continue;
+		}
+		if (c->sampledat && t > c->sampledat)
+			c->cpu = (ticks - c->cputicks) * 1000000
+				/ (sysconf(_SC_CLK_TCK) * (t - c->sampledat));
+		c->cputicks = ticks;
+		c->sampledat = t;
+		c->rss = rss * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+	seat->sampleat += samplebatch;
+	if (seat->sampleat >= n)
+		seat->sampleat = 0;
+	if (LENGTH(v) * n > seat->usagecap) {
+		seat->usagecap = MAX(LENGTH(v) * n, 2 * seat->usagecap);
+		free(seat->usage);
+		seat->usage = ecalloc(seat->usagecap, sizeof(long));
+		changed = 1;
+	}
+	for (c = themon->clients, i = 0; c; c = c->next) {
+		v[0] = c->win;
+		v[1] = c->pid;
+		v[2] = c->cpu;
+		v[3] = c->rss;
+		v[4] = c->pixmaps;
+		v[5] = c->windows;
+		for (j = 0; j < LENGTH(v); j++, i++)
+			if (seat->usage[i] != v[j]) {
+				seat->usage[i] = v[j];
+				changed = 1;
+			}
+	}
+	if (changed || i != seat->nusage)
+		XChangeProperty(dpy, root, seat->usageatom, XA_CARDINAL, 32,
+			PropModeReplace, (unsigned char *)seat->usage, i);
+	seat->nusage = i;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	seat->samplelast = (t1.tv_sec - t0.tv_sec) * 1000000
+		+ (t1.tv_nsec - t0.tv_nsec) / 1000;
+	seat->samplemax = MAX(seat->samplemax, seat->samplelast);
+	if (themon->clients)
+		settimer(TmSample, sampleinterval);
+}
+
+/* remembers the tag of c and, unless a layout placed it, its geometry */
+void
+savegeom(Client *c) {
+	Geom *g;
+
+	if (!geomhdr || !c->geomkey || !c->tags)
+		return;
+	g = getgeom(c->geomkey, 1);
+	g->tags = c->tags;
+	g->used = time(NULL);
+	if (c->isfullscreen) {
+		g->x = c->oldx;
+		g->y = c->oldy;
+		g->w = c->oldw;
+		g->h = c->oldh;
+	} else if (c->isfloating || !themon->lt[ffs(c->tags)]->arrange) {
+		g->x = c->x;
+		g->y = c->y;
+		g->w = c->w;
+		g->h = c->h;
+	}
 }
 
+#ifdef PNG
+/* stretches src over dst, interpolating bilinearly in 16.16 fixed point */
+void
+scalebg(const uint32_t *src, int w, int h, uint32_t *dst, int dw, int dh) {
+	const uint32_t *r0, *r1;
+	uint32_t a, b, c, d, p;
+	long fx, fy, sx = ((long)w << 16) / dw, sy = ((long)h << 16) / dh;
+	unsigned int i, wx, wy;
+	int x, y, x0, y0;
+
+	for (y = 0; y < dh; y++) {
+		fy = MAX(0, y * sy + sy / 2 - 0x8000);
+		y0 = MIN(fy >> 16, h - 1);
+		wy = fy & 0xffff;
+		r0 = src + (long)y0 * w;
+		r1 = src + (long)MIN(y0 + 1, h - 1) * w;
+		for (x = 0; x < dw; x++) {
+			fx = MAX(0, x * sx + sx / 2 - 0x8000);
+			x0 = MIN(fx >> 16, w - 1);
+			wx = fx & 0xffff;
+			a = r0[x0];
+			b = r0[MIN(x0 + 1, w - 1)];
+			c = r1[x0];
+			d = r1[MIN(x0 + 1, w - 1)];
+			for (p = 0, i = 0; i < 32; i += 8)
+				p |= (uint32_t)(((((a >> i & 0xff) * (0x10000 - wx)
+				    + (b >> i & 0xff) * wx) >> 16) * (0x10000 - wy)
+				    + (((c >> i & 0xff) * (0x10000 - wx)
+				    + (d >> i & 0xff) * wx) >> 16) * wy)
+				    >> 16) << i;
+			*dst++ = p;
+		}
+	}
+}
+#endif /* PNG */
+
 void
 scan(void) {
 	unsigned int i, num;
@@ -891,6 +2686,115 @@ scan(void) {
 	}
 }
 
+/* Sets background, stretched to the screen, as root background and
+ * publishes it for pseudo-transparent clients. The scaled pixels are kept
+ * in $HOME/bgcache and mapped from there as long as neither the PNG nor
+ * the screen size changes */
+void
+setbackground(void) {
+#ifdef PNG
+	char path[512];
+	const char *home, *key;
+	struct stat st, cst;
+	png_image png;
+	BgHdr *hdr = MAP_FAILED;
+	uint32_t *src, *px = NULL;
+	size_t size = sizeof(BgHdr) + (size_t)sw * sh * sizeof(uint32_t);
+	Visual *vis = DefaultVisual(dpy, screen);
+	XImage *img;
+	Pixmap pm;
+	int fd = -1;
+
+	if (!background[0])
+		return;
+	if (DefaultDepth(dpy, screen) < 24 || vis->red_mask != 0xff0000
+	|| vis->green_mask != 0xff00 || vis->blue_mask != 0xff) {
+		fprintf(stderr, "speck: background needs a 24 bit visual\n");
+		return;
+	}
+	if (stat(background, &st) == -1) {
+		fprintf(stderr, "speck: stat %s: %s\n", background,
+			strerror(errno));
+		return;
+	}
+	if (bgcache[0] && (home = getenv("HOME"))) {
+		key = seatkey();
+		snprintf(path, sizeof path, "%s/%s%s%s", home, bgcache,
+			 key[0] ? "-" : "", key);
+		fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	}
+	if (fd != -1 && fstat(fd, &cst) == 0 && (size_t)cst.st_size == size)
+		hdr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr != MAP_FAILED && hdr->magic == BGMAGIC
+	&& hdr->w == (uint32_t)sw && hdr->h == (uint32_t)sh
+	&& hdr->mtime == st.st_mtime && hdr->size == st.st_size) {
+		px = (uint32_t *)(hdr + 1);
+	} else {
+		memset(&png, 0, sizeof png);
+		png.version = PNG_IMAGE_VERSION;
+		if (!png_image_begin_read_from_file(&png, background)) {
+			fprintf(stderr, "speck: %s: %s\n", background,
+				png.message);
+			goto out;
+		}
+		/* byte order giving 0xAARRGGBB pixels */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		png.format = PNG_FORMAT_ARGB;
+#else
+		png.format = PNG_FORMAT_BGRA;
+#endif
+		src = ecalloc(png.width * png.height, sizeof(uint32_t));
+		if (!png_image_finish_read(&png, NULL, src, 0, NULL)) {
+			fprintf(stderr, "speck: %s: %s\n", background,
+				png.message);
+			free(src);
+			goto out;
+		}
+		if (hdr == MAP_FAILED && fd != -1 && ftruncate(fd, 0) == 0
+		&& ftruncate(fd, size) == 0)
+			hdr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+				   fd, 0);
+		if (hdr != MAP_FAILED) {
+			hdr->magic = 0; /* valid once the pixels are in */
+			px = (uint32_t *)(hdr + 1);
+		} else
+			px = ecalloc((size_t)sw * sh, sizeof(uint32_t));
+		scalebg(src, png.width, png.height, px, sw, sh);
+		free(src);
+		if (hdr != MAP_FAILED) {
+			hdr->mtime = st.st_mtime;
+			hdr->size = st.st_size;
+			hdr->w = sw;
+			hdr->h = sh;
+			hdr->magic = BGMAGIC;
+		}
+	}
+	pm = XCreatePixmap(dpy, root, sw, sh, DefaultDepth(dpy, screen));
+	img = XCreateImage(dpy, vis, DefaultDepth(dpy, screen), ZPixmap, 0,
+			   (char *)px, sw, sh, 32, 0);
+	img->byte_order = *(char *)&(int){ 1 } ? LSBFirst : MSBFirst;
+	XPutImage(dpy, pm, DefaultGC(dpy, screen), img, 0, 0, 0, 0, sw, sh);
+	img->data = NULL; /* px is ours */
+	XDestroyImage(img);
+	XSetWindowBackgroundPixmap(dpy, root, pm);
+	XClearWindow(dpy, root);
+	XChangeProperty(dpy, root, seat->rootpmapatom, XA_PIXMAP, 32,
+		PropModeReplace, (unsigned char *)&pm, 1);
+	XChangeProperty(dpy, root, seat->esetrootatom, XA_PIXMAP, 32,
+		PropModeReplace, (unsigned char *)&pm, 1);
+	if (seat->bgpixmap)
+		XFreePixmap(dpy, seat->bgpixmap);
+	seat->bgpixmap = pm;
+	if (hdr == MAP_FAILED)
+		free(px);
+out:
+	if (hdr != MAP_FAILED)
+		munmap(hdr, size);
+	if (fd != -1)
+		close(fd);
+#endif /* PNG */
+}
+
 void
 setclientstate(Client *c, long state) {
 	long data[] = { state, None };
@@ -899,6 +2803,21 @@ setclientstate(Client *c, long state) {
 		PropModeReplace, (unsigned char *)data, 2);
 }
 
+/* display name for files and cgroups of a farm, "" for a single display */
+const char *
+seatkey(void) {
+	static char buf[64];
+	char *p;
+
+	if (nseats < 2 || !seat->name)
+		return "";
+	snprintf(buf, sizeof buf, "%s", seat->name);
+	for (p = buf; *p; p++)
+		if (*p == '/')
+			*p = '_';
+	return buf;
+}
+
 int
 sendevent(Client *c, Atom proto) {
 	int n;
@@ -918,6 +2837,7 @@ sendevent(Client *c, Atom proto) {
 		ev.xclient.format = 32;
 		ev.xclient.data.l[0] = proto;
 		ev.xclient.data.l[1] = CurrentTime;
+		ev.xclient.data.l[2] = c->win; /* only read by _NET_WM_PING */
 		XSendEvent(dpy, c->win, False, NoEventMask, &ev);
 	}
 	return exists;
@@ -936,6 +2856,8 @@ setfocus(Client *c) {
 
 void
 setfullscreen(Client *c, int fullscreen) {
+	long bypass = 1;
+
 	if (fullscreen && !c->isfullscreen) {
 		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
 		    PropModeReplace, (unsigned char*)&netatom[NetWMFullscreen], 1);
@@ -943,10 +2865,23 @@ setfullscreen(Client *c, int fullscreen) {
 		c->oldbw = c->bw;
 		c->bw = 0;
 		resizeclient(c, 0, 0, themon->mw, themon->mh);
-		XRaiseWindow(dpy, c->win);
+		restack(themon);
+		/* 2 asks to stay composited, 1 is kept as the client set it */
+		c->bypass = getcardprop(c, netatom[NetWMBypassCompositor]);
+		if (!c->bypass)
+			XChangeProperty(dpy, c->win,
+			    netatom[NetWMBypassCompositor], XA_CARDINAL, 32,
+			    PropModeReplace, (unsigned char *)&bypass, 1);
+		unocclude();
+		occlude(c);
 	} else if (!fullscreen && c->isfullscreen){
 		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
 		    PropModeReplace, (unsigned char*)0, 0);
+		if (!c->bypass)
+			XDeleteProperty(dpy, c->win,
+			    netatom[NetWMBypassCompositor]);
+		if (themon->fullscreen == c)
+			unocclude();
 		c->isfullscreen = 0;
 		c->bw = c->oldbw;
 		c->x = c->oldx;
@@ -958,13 +2893,131 @@ setfullscreen(Client *c, int fullscreen) {
 	}
 }
 
+void
+setlayout(const Arg *arg) {
+	themon->lt[ffs(themon->tagset[themon->seltag])] = arg->v;
+	arrange(1);
+}
+
+/* moves c into the transient group of p, to the top of its siblings, or
+ * makes it stand alone without p. Links that would form a cycle are
+ * ignored */
+void
+setparent(Client *c, Client *p) {
+	Client *t;
+
+	for (t = p; t; t = t->parent)
+		if (t == c)
+			return;
+	if (c->parent) {
+		if (c->sibprev)
+			c->sibprev->sib = c->sib;
+		else
+			c->parent->kids = c->sib;
+		if (c->sib)
+			c->sib->sibprev = c->sibprev;
+	}
+	c->parent = p;
+	c->sibprev = NULL;
+	c->sib = p ? p->kids : NULL;
+	if (c->sib)
+		c->sib->sibprev = c;
+	if (p)
+		p->kids = c;
+}
+
+/* Keeps speck ahead of the load on the box. The client arena is allocated
+ * here, main() locks memory after the seats are set up, and spawned
+ * programs get the default scheduling back through SCHED_RESET_ON_FORK */
+void
+setrealtime(void) {
+	struct sched_param sp = { 0 };
+	unsigned int i;
+
+	arena = ecalloc(maxclients, sizeof(Client));
+	for (i = maxclients; i > 0; i--) {
+		arena[i - 1].next = freeclients;
+		freeclients = &arena[i - 1];
+	}
+	if (rtprio > 0) {
+		sp.sched_priority = rtprio;
+		if (sched_setscheduler(0, SCHED_RR|SCHED_RESET_ON_FORK,
+		    &sp) == 0)
+			return;
+		fprintf(stderr, "speck: SCHED_RR: %s\n", strerror(errno));
+		sp.sched_priority = 0;
+	}
+	if (sched_setscheduler(0, SCHED_OTHER|SCHED_RESET_ON_FORK, &sp) == -1
+	|| setpriority(PRIO_PROCESS, 0, -niceboost) == -1)
+		fprintf(stderr, "speck: nice: %s\n", strerror(errno));
+}
+
+/* moves c and its transients to tags */
+void
+settags(Client *c, unsigned int tags) {
+	Client *t;
+
+	if (!(tags & themon->tagset[themon->seltag]))
+		uncarve(c);
+	detachtag(c);
+	c->tags = tags;
+	attachtag(c);
+	if (ISVISIBLE(c))
+		carve(c);
+	cgplace(c->pid, tags);
+	for (t = c->kids; t; t = t->sib)
+		settags(t, tags);
+}
+
+/* arm timer t to fire in ms unless it is due earlier already */
+void
+settimer(int t, long ms) {
+	long when = now() + ms;
+
+	if (seat->timers[t] && seat->timers[t] <= when)
+		return;
+	seat->timers[t] = when;
+	armtimers();
+}
+
+/* what all displays share, done before any is opened */
 void
 setup(void) {
+	sigset_t sm;
+
+	/* signals are read from sigfd in run(), timers fire through timerfd */
+	sigemptyset(&sm);
+	sigaddset(&sm, SIGCHLD);
+	sigaddset(&sm, SIGTERM);
+	sigaddset(&sm, SIGUSR1);
+	if (sigprocmask(SIG_BLOCK, &sm, NULL) == -1)
+		die("sigprocmask:");
+	if ((sigfd = signalfd(-1, &sm, SFD_NONBLOCK|SFD_CLOEXEC)) == -1)
+		die("signalfd:");
+	/* clean up any zombies immediately */
+	while (0 < waitpid(-1, NULL, WNOHANG));
+	if (!numtags || numtags > MAXTAGS)
+		die("speck: numtags must be 1 to %u", (unsigned int)MAXTAGS);
+	if (realtime)
+		setrealtime();
+}
+
+void
+setupseat(void) {
 	XSetWindowAttributes wa;
+	XGCValues gv;
 	Atom utf8string;
-
-	/* clean up any zombies immediately */
-	sigchld(0);
+#ifdef XRES
+	int eb, erb;
+#endif /* XRES */
+
+	if ((seat->timerfd = timerfd_create(CLOCK_MONOTONIC,
+	    TFD_NONBLOCK|TFD_CLOEXEC)) == -1)
+		die("timerfd_create:");
+	/* keep the X connection out of spawned programs */
+	if (fcntl(ConnectionNumber(dpy), F_SETFD, FD_CLOEXEC) == -1)
+		die("fcntl:");
+	XSetIOErrorExitHandler(dpy, xioerror, seat);
 
 	/* init screen */
 	screen = DefaultScreen(dpy);
@@ -978,6 +3031,10 @@ setup(void) {
 	wmatom[WMDelete] = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
 	wmatom[WMState] = XInternAtom(dpy, "WM_STATE", False);
 	wmatom[WMTakeFocus] = XInternAtom(dpy, "WM_TAKE_FOCUS", False);
+	wmatom[WMWindowRole] = XInternAtom(dpy, "WM_WINDOW_ROLE", False);
+	seat->usageatom = XInternAtom(dpy, "_SPECK_USAGE", False);
+	seat->rootpmapatom = XInternAtom(dpy, "_XROOTPMAP_ID", False);
+	seat->esetrootatom = XInternAtom(dpy, "ESETROOT_PMAP_ID", False);
 	netatom[NetActiveWindow] = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
 	netatom[NetSupported] = XInternAtom(dpy, "_NET_SUPPORTED", False);
 	netatom[NetWMName] = XInternAtom(dpy, "_NET_WM_NAME", False);
@@ -989,76 +3046,309 @@ setup(void) {
 	netatom[NetWMWindowTypeDialog] =
 	    XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	netatom[NetWMPing] = XInternAtom(dpy, "_NET_WM_PING", False);
+	netatom[NetWMPid] = XInternAtom(dpy, "_NET_WM_PID", False);
+	netatom[NetWMBypassCompositor] =
+	    XInternAtom(dpy, "_NET_WM_BYPASS_COMPOSITOR", False);
+	netatom[NetClientListStacking] =
+	    XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
+	netatom[NetStartupId] = XInternAtom(dpy, "_NET_STARTUP_ID", False);
 	/* init border colors */
 	XAllocNamedColor(dpy, DefaultColormap(dpy, screen), col_focus,
-		     &focusbordercolor, &dummy);
+		     &seat->focusbordercolor, &dummy);
 	XAllocNamedColor(dpy, DefaultColormap(dpy, screen), col_unfocus,
-		     &unfocusbordercolor, &dummy);
+		     &seat->unfocusbordercolor, &dummy);
+	/* outline for dragging, drawn across the client windows */
+	gv.function = GXinvert;
+	gv.subwindow_mode = IncludeInferiors;
+	gv.line_width = borderpx;
+	seat->outlinegc = XCreateGC(dpy, root,
+				    GCFunction|GCSubwindowMode|GCLineWidth, &gv);
 	/* supporting window for NetWMCheck */
-	wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
-	XChangeProperty(dpy, wmcheckwin, netatom[NetWMCheck], XA_WINDOW, 32,
-		PropModeReplace, (unsigned char *) &wmcheckwin, 1);
-	XChangeProperty(dpy, wmcheckwin, netatom[NetWMName], utf8string, 8,
-		PropModeReplace, (unsigned char *) "speck", 5);
+	seat->wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
+	XChangeProperty(dpy, seat->wmcheckwin, netatom[NetWMCheck], XA_WINDOW,
+		32, PropModeReplace, (unsigned char *) &seat->wmcheckwin, 1);
+	XChangeProperty(dpy, seat->wmcheckwin, netatom[NetWMName], utf8string,
+		8, PropModeReplace, (unsigned char *) "speck", 5);
 	XChangeProperty(dpy, root, netatom[NetWMCheck], XA_WINDOW, 32,
-		PropModeReplace, (unsigned char *) &wmcheckwin, 1);
+		PropModeReplace, (unsigned char *) &seat->wmcheckwin, 1);
 	/* EWMH support per view */
 	XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
 		PropModeReplace, (unsigned char *) netatom, NetLast);
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
+	XDeleteProperty(dpy, root, seat->usageatom);
+	settimer(TmPool, 0);
+#ifdef XRES
+	if ((seat->hasxres = XResQueryExtension(dpy, &eb, &erb)))
+		seat->reswinatom = XInternAtom(dpy, "WINDOW", False);
+#endif /* XRES */
+	cgsetup();
+	if (!geomhdr) /* shared by all displays */
+		opengeom();
+	setbackground();
+	if (realtime) {
+		themon->stackcap = maxclients;
+		themon->stacking = ecalloc(maxclients, sizeof(Window));
+		themon->stackbuf = ecalloc(maxclients, sizeof(Window));
+		growspace(8 * maxclients);
+		seat->snapcap = 2 * maxclients + 2;
+		seat->snapx = ecalloc(seat->snapcap, sizeof(Edge));
+		seat->snapy = ecalloc(seat->snapcap, sizeof(Edge));
+	}
 	/* select events */
 	wa.event_mask = SubstructureRedirectMask|SubstructureNotifyMask
-		|ButtonPressMask;
+		|StructureNotifyMask|ButtonPressMask;
 	XChangeWindowAttributes(dpy, root, CWEventMask, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
 	grabkeys();
 	focus(NULL);
 }
 
-void
-showhide(Client *c) {
-	if (!c)
-		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
-		XMoveWindow(dpy, c->win, c->x, c->y);
-		if (!c->isfullscreen)
-			resize(c, c->x, c->y, c->w, c->h);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+/* writes the kids list starting at c, each client preceded by its own
+ * transients */
+Window *
+stackfamily(Client *c, Window *w) {
+	for (; c; c = c->sib) {
+		w = stackfamily(c->kids, w);
+		*w++ = c->win;
 	}
+	return w;
 }
 
 void
-sigchld(int unused) {
-	if (signal(SIGCHLD, sigchld) == SIG_ERR)
-		die("can't install SIGCHLD handler:");
-	while (0 < waitpid(-1, NULL, WNOHANG));
+showclient(Client *c) {
+	c->hiddenat = 0;
+	if (c->isfrozen)
+		thaw(c);
+	XMoveWindow(dpy, c->win, c->x, c->y);
+	if (!c->isfullscreen)
+		resize(c, c->x, c->y, c->w, c->h);
+}
+
+void
+showhide(void) {
+	Client *c;
+
+	/* show clients top down, then hide the rest */
+	for (c = themon->stack; c; c = c->snext)
+		if (ISVISIBLE(c))
+			showclient(c);
+	for (c = themon->stack; c; c = c->snext)
+		if (!ISVISIBLE(c))
+			hideclient(c);
+}
+
+/* Shows and hides only the clients on tags that came into or went out of
+ * view since old, found through the per-tag rings */
+void
+showhidetags(unsigned int old) {
+	unsigned int t = themon->tagset[themon->seltag], d, i;
+	Client *c, *h;
+
+	for (d = old ^ t; d; d &= d - 1) {
+		i = ffs(d) - 1;
+		if (!(h = themon->tagmru[i]))
+			continue;
+		c = h;
+		do {
+			/* once per client, from its lowest changed tag */
+			if ((unsigned int)ffs(c->tags & (old ^ t)) - 1 != i)
+				continue;
+			if (c->tags & t && !(c->tags & old))
+				showclient(c);
+			else if (!(c->tags & t) && c->tags & old)
+				hideclient(c);
+		} while ((c = c->tnext[i]) != h);
+	}
 }
 
+/* snap the span [v, v + len] to the closest edge less than snap pixels off
+ * among those near [lo, hi) on the other axis */
+int
+snapaxis(const Edge *e, unsigned int n, int v, int len, int lo, int hi) {
+	int a, b;
+
+	a = nearestedge(e, n, v, lo, hi);
+	b = nearestedge(e, n, v + len, lo, hi);
+	if (abs(b) < abs(a))
+		a = b;
+	return abs(a) < (int)snap ? v + a : v;
+}
+
+/* hands out a pooled instance of the command if one is ready */
 void
 spawn(const Arg *arg) {
-	if (fork() == 0) {
-		if (dpy)
-			close(ConnectionNumber(dpy));
-		setsid();
-		execvp(((char **)arg->v)[0], (char **)arg->v);
-		fprintf(stderr, "speck: execvp %s", ((char **)arg->v)[0]);
-		perror(" failed");
-		exit(EXIT_SUCCESS);
+	unsigned int i;
+	Client *c = NULL;
+
+	for (i = 0; i < LENGTH(pools) && pools[i].cmd != arg->v; i++);
+	if (i < LENGTH(pools)) {
+		for (c = themon->clients; c && c->pool != i + 1; c = c->next);
+		settimer(TmPool, pooldelay);
+	}
+	if (!c) {
+		cgplace(launch((const char **)arg->v, 0),
+			themon->tagset[themon->seltag]);
+		return;
 	}
+	c->pool = 0;
+	detachtag(c);
+	c->tags = themon->tagset[themon->seltag];
+	attachtag(c);
+	if (!c->hasxy && !c->isfullscreen
+	&& !themon->lt[ffs(themon->tagset[themon->seltag])]->arrange)
+		place(c);
+	carve(c);
+	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
+	    PropModeAppend, (unsigned char *) &(c->win), 1);
+	cgplace(c->pid, c->tags);
+	focus(c);
+	arrange(1);
+}
+
+/* forgets the pid of a launch that exited, returns its pool. What a
+ * spawn() child started may still map, so its startup id is kept */
+unsigned int
+takelaunch(pid_t pid) {
+	unsigned int i, pool;
+
+	if (pid <= 0)
+		return 0;
+	for (i = 0; i < LENGTH(seat->launches); i++)
+		if (seat->launches[i].pid == pid) {
+			if ((pool = seat->launches[i].pool))
+				memset(&seat->launches[i], 0, sizeof(Launch));
+			else
+				seat->launches[i].pid = 0;
+			return pool;
+		}
+	return 0;
 }
 
 void
 tag(const Arg *arg) {
-	if (themon->sel && arg->ui && arg->ui <= numtags) {
-		themon->sel->tag = arg->ui;
-		focus(NULL);
-		arrange(1);
+	if (themon->sel && arg->ui & TAGMASK)
+		taggroup(arg->ui & TAGMASK);
+}
+
+/* moves the transient group of the selected client to tags */
+void
+taggroup(unsigned int tags) {
+	Client *c, *t;
+
+	for (c = themon->sel; c->parent; c = c->parent);
+	for (t = themon->fullscreen; t && t != c; t = t->parent);
+	if (t)
+		unocclude();
+	settags(c, tags);
+	if (themon->sel->isfullscreen && !themon->fullscreen)
+		occlude(themon->sel);
+	focus(NULL);
+	arrange(1);
+}
+
+void
+tile(Monitor *m) {
+	unsigned int i, n;
+	int mw, ty, h;
+	Client *c;
+
+	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
+	if (n == 0)
+		return;
+	mw = n > 1 ? m->mw * mfact : m->mw;
+	for (i = ty = 0, c = nexttiled(m->clients); c;
+	     c = nexttiled(c->next), i++)
+		if (i == 0)
+			resize(c, 0, 0, mw - 2 * c->bw, m->mh - 2 * c->bw);
+		else {
+			h = (m->mh - ty) / (n - i);
+			resize(c, mw, ty, m->mw - mw - 2 * c->bw, h - 2 * c->bw);
+			if (ty + HEIGHT(c) < m->mh)
+				ty += HEIGHT(c);
+		}
+}
+
+void
+togglefloating(const Arg *arg) {
+	if (!themon->sel || themon->sel->isfullscreen)
+		return;
+	themon->sel->isfloating = !themon->sel->isfloating
+		|| themon->sel->isfixed;
+	arrange(1);
+}
+
+void
+toggletag(const Arg *arg) {
+	unsigned int tags;
+
+	if (themon->sel && (tags = themon->sel->tags ^ (arg->ui & TAGMASK)))
+		taggroup(tags);
+}
+
+void
+toggleview(const Arg *arg) {
+	unsigned int old = themon->tagset[themon->seltag];
+	unsigned int tags = old ^ (arg->ui & TAGMASK);
+
+	if (!tags)
+		return;
+	themon->tagset[themon->seltag] = tags;
+	themon->spacevalid = 0;
+	cgview();
+	focus(NULL);
+	showhidetags(old);
+	arrangemon(1);
+}
+
+void
+thaw(Client *c) {
+	Client *t;
+
+	kill(c->pid, SIGCONT);
+	for (t = themon->clients; t; t = t->next)
+		if (t->pid == c->pid)
+			t->isfrozen = 0;
+}
+
+/* Gives the area of c back to the free space index. The empty rectangles
+ * overlapping it are found by cutting every other carved client out of the
+ * screen while keeping only parts that overlap c, the old ones they
+ * contain are no longer maximal */
+void
+uncarve(Client *c) {
+	Rect r = { c->x, c->y, WIDTH(c), HEIGHT(c) }, *n, *o;
+	Client *t;
+	unsigned int i, j, k, nn = 1;
+
+	if (!c->carved)
+		return;
+	c->carved = 0;
+	if (!themon->spacevalid)
+		return;
+	growspace(5);
+	themon->spacenew[0] = (Rect){ 0, 0, themon->mw, themon->mh };
+	for (t = themon->stack; t && nn; t = t->snext)
+		if (t->carved) {
+			growspace(5 * nn);
+			nn = cut(themon->spacenew, nn, (Rect){ t->x, t->y,
+				 WIDTH(t), HEIGHT(t) }, &r);
+		}
+	growspace(themon->nspace + nn);
+	n = themon->spacenew;
+	o = themon->space;
+	for (i = k = 0; i < themon->nspace; i++) {
+		for (j = 0; j < nn; j++)
+			if (n[j].x <= o[i].x && n[j].y <= o[i].y
+			&& n[j].x + n[j].w >= o[i].x + o[i].w
+			&& n[j].y + n[j].h >= o[i].y + o[i].h)
+				break;
+		if (j == nn)
+			o[k++] = o[i];
 	}
+	memcpy(o + k, n, nn * sizeof(Rect));
+	themon->nspace = k + nn;
 }
 
 void
@@ -1066,7 +3356,8 @@ unfocus(Client *c, int setfocus) {
 	if (!c)
 		return;
 	grabbuttons(c, 0);
-	XSetWindowBorder(dpy, c->win, unfocusbordercolor.pixel);
+	if (!c->isfullscreen)
+		XSetWindowBorder(dpy, c->win, seat->unfocusbordercolor.pixel);
 	if (setfocus) {
 		XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
 		XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
@@ -1077,10 +3368,27 @@ void
 unmanage(Client *c, int destroyed) {
 	XWindowChanges wc;
 
+	if (seat->grab.func && seat->grab.c == c) /* ends with its client */
+		seat->grab.func(NULL);
+	savegeom(c);
+	if (themon->fullscreen == c)
+		unocclude();
+	setparent(c, NULL);
+	while (c->kids)
+		setparent(c->kids, NULL);
+	if (c->pool)
+		settimer(TmPool, pooldelay);
+	if (c->isfrozen) { /* the rest of the process is refrozen if hidden */
+		thaw(c);
+		settimer(TmFreeze, freezedelay);
+	}
+	uncarve(c);
+	detach(c);
+	detachtag(c);
 	detachstack(c);
 	if (!destroyed) {
 		wc.border_width = c->oldbw;
-		XGrabServer(dpy); /* avoid race conditions */
+		/* the window may be gone by now, errors are expected */
 		XSetErrorHandler(xerrordummy);
 		/* restore border */
 		XConfigureWindow(dpy, c->win, CWBorderWidth, &wc);
@@ -1088,21 +3396,39 @@ unmanage(Client *c, int destroyed) {
 		setclientstate(c, WithdrawnState);
 		XSync(dpy, False);
 		XSetErrorHandler(xerror);
-		XUngrabServer(dpy);
 	}
-	free(c);
+	freeclient(c);
 	focus(NULL);
 	updateclientlist();
 	arrange(1);
 }
 
+/* maps everything back in one go, the caller rearranges */
+void
+unocclude(void) {
+	Client *t;
+
+	if (!themon->fullscreen)
+		return;
+	themon->fullscreen = NULL;
+	for (t = themon->clients; t; t = t->next) {
+		if (!t->occluded)
+			continue;
+		t->occluded = 0;
+		setclientstate(t, NormalState);
+		XMapWindow(dpy, t->win);
+	}
+}
+
 void
 unmapnotify(XEvent *e) {
 	Client *c;
 	XUnmapEvent *ev = &e->xunmap;
 
 	if ((c = wintoclient(ev->window))) {
-		if (ev->send_event)
+		if (c->ignoreunmap && !ev->send_event)
+			c->ignoreunmap--;
+		else if (ev->send_event)
 			setclientstate(c, WithdrawnState);
 		else
 			unmanage(c, 0);
@@ -1115,7 +3441,8 @@ updateclientlist() {
 
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
 	for (c = themon->stack; c; c = c->snext)
-		XChangeProperty(dpy, root, netatom[NetClientList],
+		if (!c->pool)
+			XChangeProperty(dpy, root, netatom[NetClientList],
 				XA_WINDOW, 32, PropModeAppend,
 				(unsigned char *) &(c->win), 1);
 }
@@ -1174,11 +3501,34 @@ updatesizehints(Client *c) {
 		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
 	} else
 		c->maxa = c->mina = 0.0;
+	if (size.flags & USPosition)
+		c->hasxy = 1;
 	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw &&
 		      c->maxh == c->minh);
 	c->hintsvalid = 1;
 }
 
+/* follows WM_TRANSIENT_FOR changes, joining the new parent's tags */
+void
+updatetransient(Client *c) {
+	Window trans = None;
+	Client *p = NULL;
+
+	if (XGetTransientForHint(dpy, c->win, &trans))
+		p = wintoclient(trans);
+	if (p == c->parent)
+		return;
+	setparent(c, p);
+	if (c->parent != p)
+		return;
+	if (p) {
+		c->isfloating = 1;
+		if (!c->pool && c->tags != p->tags)
+			settags(c, p->tags);
+	}
+	arrange(1);
+}
+
 void
 updatewindowtype(Client *c) {
 	Atom state = getatomprop(c, netatom[NetWMState]);
@@ -1200,15 +3550,64 @@ updatewmhints(Client *c) {
 	}
 }
 
+/* makes s the display in use, dwm's globals go back to the one before */
+void
+useseat(Seat *s) {
+	Seat *o = seat;
+
+	if (s == o)
+		return;
+	if (o) {
+		o->dpy = dpy;
+		o->themon = themon;
+		o->root = root;
+		o->screen = screen;
+		o->sw = sw;
+		o->sh = sh;
+		o->numlockmask = numlockmask;
+	}
+	dpy = s->dpy;
+	themon = s->themon;
+	root = s->root;
+	screen = s->screen;
+	sw = s->sw;
+	sh = s->sh;
+	numlockmask = s->numlockmask;
+	wmatom = s->wmatom;
+	netatom = s->netatom;
+	seat = s;
+}
+
 void
 view(const Arg *arg) {
-	if (arg->ui == themon->tagset[themon->seltag])
+	unsigned int old;
+
+	if ((arg->ui & TAGMASK) == themon->tagset[themon->seltag])
 		return;
+	old = themon->tagset[themon->seltag];
 	themon->seltag ^= 1; /* toggle sel tagset */
-	if (arg->ui && arg->ui <= numtags)
-		themon->tagset[themon->seltag] = arg->ui;
+	if (arg->ui & TAGMASK)
+		themon->tagset[themon->seltag] = arg->ui & TAGMASK;
+	themon->spacevalid = 0;
+	cgview();
 	focus(NULL);
-	arrange(1);
+	showhidetags(old);
+	arrangemon(1);
+}
+
+/* the most recently focused client of the view, from the heads of the
+ * rings of its tags */
+Client *
+viewmru(void) {
+	unsigned int t, i;
+	Client *c = NULL, *h;
+
+	for (t = themon->tagset[themon->seltag]; t; t &= t - 1) {
+		i = ffs(t) - 1;
+		if ((h = themon->tagmru[i]) && (!c || h->mruseq > c->mruseq))
+			c = h;
+	}
+	return c;
 }
 
 Client *
@@ -1255,25 +3654,74 @@ xerrorstart(Display *dpy, XErrorEvent *ee) {
 	return -1;
 }
 
+/* Called instead of exiting when a connection breaks, so that one X server
+ * going away leaves the other displays managed. run() drops its seat */
+void
+xioerror(Display *dpy, void *arg) {
+	Seat *s = arg;
+
+	fprintf(stderr, "speck: lost display %s\n", s->name ? s->name : "");
+	s->lost = 1;
+}
+
+#ifdef XRES
+/* pixmap bytes and windows held by the X connection c belongs to */
+void
+xresstat(Client *c) {
+	XResType *types;
+	unsigned long bytes;
+	int i, n;
+
+	c->pixmaps = XResQueryClientPixmapBytes(dpy, c->win, &bytes)
+		? (long)(bytes / 1024) : 0;
+	c->windows = 0;
+	if (!XResQueryClientResources(dpy, c->win, &n, &types))
+		return;
+	for (i = 0; i < n; i++)
+		if (types[i].resource_type == seat->reswinatom)
+			c->windows = types[i].count;
+	XFree(types);
+}
+#endif /* XRES */
+
 int
 main(int argc, char *argv[]) {
+	unsigned int i;
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("speck-"VERSION);
-	else if (argc != 1)
-		die("usage: speck [-v]");
+	for (i = 1; i < (unsigned int)argc; i++)
+		if (argv[i][0] == '-')
+			die("usage: speck [-v] [display ...]");
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
-	if (!(dpy = XOpenDisplay(NULL)))
-		die("speck: cannot open display");
-	checkotherwm();
+	/* one seat for $DISPLAY or, as a farm, one per display given */
+	nseats = argc > 1 ? argc - 1 : 1;
+	seats = ecalloc(nseats, sizeof(Seat));
+	for (i = 0; i + 1 < (unsigned int)argc; i++)
+		seats[i].name = argv[i + 1];
 	setup();
-#ifdef __OpenBSD__
-	if (pledge("stdio proc exec", NULL) == -1)
-		die("pledge");
-#endif /* __OpenBSD__ */
-	scan();
+	for (i = 0; i < nseats; i++) {
+		useseat(&seats[i]);
+		if (!(dpy = seat->dpy = XOpenDisplay(seat->name)))
+			die("speck: cannot open display %s",
+			    seat->name ? seat->name : "");
+		checkotherwm();
+		setupseat();
+		scan();
+	}
+	/* lock only now: the arena and per-seat buffers exist, and later
+	 * one-off allocations such as a background rescale stay unlocked */
+	if (realtime && mlockall(MCL_CURRENT) == -1)
+		fprintf(stderr, "speck: mlockall: %s\n", strerror(errno));
 	run();
+	for (i = 0; i < nseats; i++) {
+		if (!seats[i].dpy) /* dropped */
+			continue;
+		useseat(&seats[i]);
+		cleanupseat();
+		XCloseDisplay(dpy);
+	}
 	cleanup();
-	XCloseDisplay(dpy);
 	return EXIT_SUCCESS;
 }
@@ -1,42 +1,313 @@
-/* cc transient.c -o transient -lX11 */
-
+/* stress and soak generator for speck
+ * cc transient.c -o transient -lX11
+ *
+ * Keeps up to -n windows alive, creating -r of them per second (-t percent
+ * of those transient for another one) and destroying the oldest once the
+ * limit is reached. On top of that it issues -c ConfigureRequests, -p
+ * property changes and -f _NET_WM_STATE fullscreen toggles per second.
+ * Every -i seconds it prints how long the window manager took to map and
+ * configure the windows, the X server round trip and, given the pid of
+ * speck with -w, its RSS and growth since the start, e.g.:
+ *
+ *	Xvfb :9 & DISPLAY=:9 speck & DISPLAY=:9 ./transient -w $! -d 3600
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/types.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
-int main(void) {
-	Display *d;
-	Window r, f, t = None;
+typedef struct {
+	Window win;
+	long mapsent, cfgsent; /* us, 0 if nothing is outstanding */
+} Win;
+
+typedef struct {
+	unsigned long n;
+	long sum, max;
+} Stat;
+
+static void configure(void);
+static void create(void);
+static void destroy(void);
+static void fullscreen(void);
+static void handle(XEvent *ev);
+static long now(void);
+static void property(void);
+static Win *randwin(void);
+static void report(long elapsed);
+static long rss(void);
+static void sample(Stat *s, long us);
+static void usage(void);
+static int xerror(Display *dpy, XErrorEvent *ee);
+
+static Display *dpy;
+static Window root;
+static Atom netwmstate, netwmfullscreen;
+static XContext ctx;
+static Win *wins;
+static int maxwins = 200, head, nwins;
+static int transientpct = 25;
+static unsigned long made, errors, props;
+static Stat mapstat, cfgstat;
+static pid_t wmpid;
+static long rss0 = -1;
+
+void
+configure(void) {
+	Win *w;
+
+	if (!(w = randwin()))
+		return;
+	XMoveResizeWindow(dpy, w->win, rand() % 800, rand() % 600,
+			  50 + rand() % 400, 50 + rand() % 400);
+	w->cfgsent = now();
+}
+
+void
+create(void) {
+	Win *w, *p;
 	XSizeHints h;
-	XEvent e;
 
-	d = XOpenDisplay(NULL);
-	if (!d)
+	if (nwins == maxwins)
+		destroy();
+	p = randwin();
+	w = &wins[(head + nwins++) % maxwins];
+	w->win = XCreateSimpleWindow(dpy, root, rand() % 800, rand() % 600,
+				     50 + rand() % 400, 50 + rand() % 400, 0, 0,
+				     0);
+	w->cfgsent = 0;
+	h.min_width = h.min_height = 20;
+	h.flags = PMinSize;
+	XSetWMNormalHints(dpy, w->win, &h);
+	XStoreName(dpy, w->win, "transient");
+	if (p && rand() % 100 < transientpct)
+		XSetTransientForHint(dpy, w->win, p->win);
+	XSelectInput(dpy, w->win, StructureNotifyMask);
+	XSaveContext(dpy, w->win, ctx, (XPointer)w);
+	XMapWindow(dpy, w->win);
+	w->mapsent = now();
+	made++;
+}
+
+/* destroys the oldest window */
+void
+destroy(void) {
+	Win *w = &wins[head];
+
+	XDeleteContext(dpy, w->win, ctx);
+	XDestroyWindow(dpy, w->win);
+	head = (head + 1) % maxwins;
+	nwins--;
+}
+
+void
+fullscreen(void) {
+	Win *w;
+	XEvent ev;
+
+	if (!(w = randwin()))
+		return;
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = w->win;
+	ev.xclient.message_type = netwmstate;
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = 2; /* _NET_WM_STATE_TOGGLE */
+	ev.xclient.data.l[1] = netwmfullscreen;
+	ev.xclient.data.l[2] = 0;
+	ev.xclient.data.l[3] = 1;
+	ev.xclient.data.l[4] = 0;
+	XSendEvent(dpy, root, False,
+		   SubstructureNotifyMask|SubstructureRedirectMask, &ev);
+}
+
+void
+handle(XEvent *ev) {
+	Win *w;
+
+	if (XFindContext(dpy, ev->xany.window, ctx, (XPointer *)&w))
+		return;
+	switch (ev->type) {
+	case MapNotify:
+		if (w->mapsent)
+			sample(&mapstat, now() - w->mapsent);
+		w->mapsent = 0;
+		break;
+	case ConfigureNotify:
+		if (w->cfgsent)
+			sample(&cfgstat, now() - w->cfgsent);
+		w->cfgsent = 0;
+		break;
+	}
+}
+
+long
+now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* alternates between renaming a window and flipping its WM_HINTS */
+void
+property(void) {
+	Win *w;
+	XWMHints wmh;
+	char name[32];
+
+	if (!(w = randwin()))
+		return;
+	if (++props % 2) {
+		snprintf(name, sizeof name, "transient %lu", props);
+		XStoreName(dpy, w->win, name);
+	} else {
+		wmh.flags = InputHint;
+		wmh.input = props % 4 == 0;
+		XSetWMHints(dpy, w->win, &wmh);
+	}
+}
+
+Win *
+randwin(void) {
+	return nwins ? &wins[(head + rand() % nwins) % maxwins] : NULL;
+}
+
+void
+report(long elapsed) {
+	long t, kb;
+
+	t = now();
+	XSync(dpy, False);
+	t = now() - t;
+	kb = rss();
+	if (rss0 < 0)
+		rss0 = kb;
+	printf("%6lds live %4d made %8lu err %4lu "
+	       "map %7.2f/%7.2fms cfg %7.2f/%7.2fms sync %6.2fms",
+	       elapsed / 1000000, nwins, made, errors,
+	       mapstat.n ? mapstat.sum / 1000.0 / mapstat.n : 0.0,
+	       mapstat.max / 1000.0,
+	       cfgstat.n ? cfgstat.sum / 1000.0 / cfgstat.n : 0.0,
+	       cfgstat.max / 1000.0, t / 1000.0);
+	if (kb >= 0)
+		printf(" rss %ldkB (%+ldkB)", kb, kb - rss0);
+	putchar('\n');
+	fflush(stdout);
+	mapstat.n = mapstat.sum = mapstat.max = 0;
+	cfgstat.n = cfgstat.sum = cfgstat.max = 0;
+}
+
+/* resident set size of the window manager in kB, -1 if unknown */
+long
+rss(void) {
+	char path[64];
+	long pages, res = -1;
+	FILE *f;
+
+	if (!wmpid)
+		return -1;
+	snprintf(path, sizeof path, "/proc/%d/statm", (int)wmpid);
+	if (!(f = fopen(path, "r")))
+		return -1;
+	if (fscanf(f, "%ld %ld", &pages, &res) != 2)
+		res = -1;
+	fclose(f);
+	return res < 0 ? -1 : res * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void
+sample(Stat *s, long us) {
+	s->n++;
+	s->sum += us;
+	if (us > s->max)
+		s->max = us;
+}
+
+void
+usage(void) {
+	fputs("usage: transient [-n maxwins] [-r creates/s] [-t transient%] "
+	      "[-c configures/s]\n"
+	      "                 [-p properties/s] [-f fullscreens/s] "
+	      "[-d seconds] [-i seconds] [-w wmpid]\n", stderr);
+	exit(1);
+}
+
+/* windows may still be in flight while they are destroyed */
+int
+xerror(Display *dpy, XErrorEvent *ee) {
+	errors++;
+	return 0;
+}
+
+int
+main(int argc, char *argv[]) {
+	double rate[4] = { 100, 50, 50, 1 }; /* create, configure, prop, fs */
+	double due[4] = { 0, 0, 0, 0 };
+	void (*action[4])(void) = { create, configure, property, fullscreen };
+	long start, last, lastreport, t, duration = 0, interval = 10;
+	int i, o;
+	struct pollfd pfd;
+	XEvent ev;
+
+	while ((o = getopt(argc, argv, "n:r:t:c:p:f:d:i:w:")) != -1) {
+		switch (o) {
+		case 'n': maxwins = atoi(optarg); break;
+		case 'r': rate[0] = atof(optarg); break;
+		case 't': transientpct = atoi(optarg); break;
+		case 'c': rate[1] = atof(optarg); break;
+		case 'p': rate[2] = atof(optarg); break;
+		case 'f': rate[3] = atof(optarg); break;
+		case 'd': duration = atol(optarg); break;
+		case 'i': interval = atol(optarg); break;
+		case 'w': wmpid = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (optind != argc || maxwins < 1 || interval < 1)
+		usage();
+
+	if (!(dpy = XOpenDisplay(NULL)))
 		exit(1);
-	r = DefaultRootWindow(d);
-
-	f = XCreateSimpleWindow(d, r, 100, 100, 400, 400, 0, 0, 0);
-	h.min_width = h.max_width = h.min_height = h.max_height = 400;
-	h.flags = PMinSize | PMaxSize;
-	XSetWMNormalHints(d, f, &h);
-	XStoreName(d, f, "floating");
-	XMapWindow(d, f);
-
-	XSelectInput(d, f, ExposureMask);
-	while (1) {
-		XNextEvent(d, &e);
-
-		if (t == None) {
-			sleep(5);
-			t = XCreateSimpleWindow(d, r, 50, 50, 100, 100, 0, 0, 0);
-			XSetTransientForHint(d, t, f);
-			XStoreName(d, t, "transient");
-			XMapWindow(d, t);
-			XSelectInput(d, t, ExposureMask);
+	if (!(wins = calloc(maxwins, sizeof(Win))))
+		exit(1);
+	root = DefaultRootWindow(dpy);
+	netwmstate = XInternAtom(dpy, "_NET_WM_STATE", False);
+	netwmfullscreen = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	ctx = XUniqueContext();
+	XSetErrorHandler(xerror);
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+
+	start = last = lastreport = now();
+	report(0);
+	while (!duration || last - start < duration * 1000000) {
+		XFlush(dpy);
+		poll(&pfd, 1, 5);
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			handle(&ev);
+		}
+		t = now();
+		for (i = 0; i < 4; i++)
+			for (due[i] += rate[i] * (t - last) / 1000000.0;
+			     due[i] >= 1; due[i]--)
+				action[i]();
+		last = t;
+		if (t - lastreport >= interval * 1000000) {
+			report(t - start);
+			lastreport = t;
 		}
 	}
+	while (nwins)
+		destroy();
+	report(now() - start);
 
-	XCloseDisplay(d);
+	free(wins);
+	XCloseDisplay(dpy);
 	exit(0);
 }